@@ -0,0 +1,258 @@
+// Time of the accumulation of the frame on pictures already in memory, without any decoding
+//
+// Build and run from the root of the repository:
+//
+//   make bench/accumulate
+//   ./bench/accumulate [-r repetitions] [-c cpu] [-k kernels] [-n percentages] [WIDTHxHEIGHT...]
+//
+// Each shape is a synthetic picture in memory, 8 MP very wide, very tall and square by
+// default. For every row summing kernel and frame percentage, the frame is accumulated by
+// getAverageColor, a single pass over the rows, and by four getAverageBorderColor calls,
+// one per border. The thread is pinned to one processor, each case is warmed up then
+// repeated, and the median and best times are displayed. Cycles come from perf_event_open,
+// they are core cycles of user space only, and are left out when the kernel does not
+// allow them. Bytes per cycle count the 4 bytes of every pixel of the frame once.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "../include/colorflow.h"
+
+#define MAX_REPETITIONS 1000
+#define WARM_UP_NANOSECONDS 50000000
+
+static const char *kernel_names[] = {"scalar", "sse2", "avx2", "avx512"};
+#define KERNEL_AMOUNT 4
+
+// Ways of accumulating the frame
+#define SINGLE_PASS 0
+#define FOUR_BORDERS 1
+static const char *method_names[] = {"single_pass", "four_borders"};
+
+static volatile int sink;
+
+/// @brief time of a monotonic clock
+/// @return time in nanoseconds
+static int64_t getNanoseconds(void){
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (int64_t)time.tv_sec*1000000000 + time.tv_nsec;
+}
+
+/// @brief open a counter of the cycles of the calling thread in user space
+/// @return file descriptor of the counter, or -1 when perf_event_open is not available
+static int openCycleCounter(void){
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/// @brief read a cycle counter
+/// @param counter file descriptor of the counter, or -1
+/// @return cycles counted since the counter was opened, 0 without counter
+static uint64_t readCycles(int counter){
+  uint64_t cycles = 0;
+  if(counter < 0 || read(counter, &cycles, sizeof(cycles)) != sizeof(cycles)){
+    return 0;
+  }
+  return cycles;
+}
+
+/// @brief accumulate the frame of a picture once
+/// @param ctx context that holds the dimensions of the picture
+/// @param pixels picture
+/// @param method SINGLE_PASS or FOUR_BORDERS
+/// @param frame_percentage percentage of the frame, as a fraction
+static void accumulateFrame(colorflow_ctx *ctx, pixel *pixels, int method, float frame_percentage){
+  int average_RGBA[4] = {0,0,0,0};
+  int width = ctx->width;
+  int height = ctx->height;
+  if(method == SINGLE_PASS){
+    getAverageColor(ctx, pixels, width, frame_percentage, average_RGBA);
+  }
+  else{
+    // Same bounds as initBorderAccumulator
+    int up_end = (int)(height*frame_percentage);
+    int right_start = (int)(width*(1-frame_percentage));
+    int down_start = (int)((1-frame_percentage)*height);
+    int left_end = (int)(width*frame_percentage);
+    int border[4] = {0,0,0,0};
+    getAverageBorderColor(ctx, pixels, width, border, 0, up_end, 0, width);
+    getAverageBorderColor(ctx, pixels, width, border, 0, height, right_start, width);
+    getAverageBorderColor(ctx, pixels, width, border, down_start, height, 0, width);
+    getAverageBorderColor(ctx, pixels, width, border, 0, height, 0, left_end);
+    average_RGBA[0] = border[0];
+  }
+  sink += average_RGBA[0];
+}
+
+/// @brief order of two times, for qsort
+static int compareTimes(const void *a, const void *b){
+  int64_t first = *(const int64_t*)a;
+  int64_t second = *(const int64_t*)b;
+  return (first > second) - (first < second);
+}
+
+/// @brief read a list of numbers separated by commas
+/// @param argument list to read
+/// @param values array to store the numbers into
+/// @param capacity number of numbers values can hold
+/// @return number of numbers read
+static int parseList(char *argument, float *values, int capacity){
+  int amount = 0;
+  for(char *number = strtok(argument, ","); number && amount < capacity; number = strtok(NULL, ",")){
+    values[amount++] = (float)atof(number);
+  }
+  return amount;
+}
+
+int main(int argc, char *argv[]){
+  int repetitions = 21;
+  int cpu = -1;
+  char *kernel_list = NULL;
+  float percentages[32] = {1, 5, 10, 25, 50, 100};
+  int percentage_amount = 6;
+  int opt;
+  while((opt = getopt(argc, argv, "r:c:k:n:")) != -1){
+    switch(opt){
+      case 'r':
+        repetitions = atoi(optarg);
+        break;
+      case 'c':
+        cpu = atoi(optarg);
+        break;
+      case 'k':
+        kernel_list = optarg;
+        break;
+      case 'n':
+        percentage_amount = parseList(optarg, percentages, 32);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-r repetitions] [-c cpu] [-k kernels] [-n percentages] [WIDTHxHEIGHT...]\n", argv[0]);
+        return 1;
+    }
+  }
+  if(repetitions < 1 || repetitions > MAX_REPETITIONS || percentage_amount == 0){
+    fprintf(stderr, "Usage: %s [-r repetitions] [-c cpu] [-k kernels] [-n percentages] [WIDTHxHEIGHT...]\n", argv[0]);
+    return 1;
+  }
+
+  // The thread stays on one processor, the one it runs on unless told otherwise
+  if(cpu < 0){
+    cpu = sched_getcpu();
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if(sched_setaffinity(0, sizeof(cpus), &cpus) != 0){
+    perror("sched_setaffinity");
+  }
+
+  int counter = openCycleCounter();
+  if(counter >= 0){
+    ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+  }
+
+  // Default shapes of 8 MP
+  const char *default_shapes[] = {"32000x250", "250x32000", "3264x2448"};
+  int shape_amount = optind < argc ? argc - optind : 3;
+  const char **shapes = optind < argc ? (const char**)argv + optind : default_shapes;
+
+  colorflow_ctx *ctx = colorflow_ctx_create();
+  if(!ctx){
+    fprintf(stderr,"Error while allowing memory.\n");
+    return 1;
+  }
+
+  printf("# pinned to cpu %d, median and best of %d repetitions, cycles %s\n", cpu, repetitions, counter >= 0 ? "from perf_event_open" : "not available");
+  printf("%-8s %12s %5s %-13s %12s %12s %12s %12s\n", "kernel", "shape", "-n", "method", "median us", "best us", "cycles", "bytes/cycle");
+  for(int s = 0; s < shape_amount; s++){
+    int width, height;
+    if(sscanf(shapes[s], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0){
+      fprintf(stderr, "Error: %s is not a shape, WIDTHxHEIGHT\n", shapes[s]);
+      return 1;
+    }
+    pixel *pixels = (pixel*)malloc((size_t)width*height*sizeof(pixel));
+    if(!pixels){
+      fprintf(stderr,"Error while allowing memory.\n");
+      return 1;
+    }
+    srand(width ^ height);
+    for(size_t i = 0; i < (size_t)width*height; i++){
+      pixels[i] = createPixel(rand(), rand(), rand(), rand());
+    }
+    ctx->width = width;
+    ctx->height = height;
+
+    for(int k = 0; k < KERNEL_AMOUNT; k++){
+      if(kernel_list && !strstr(kernel_list, kernel_names[k])){
+        continue;
+      }
+      if(selectSumKernel(kernel_names[k])){
+        printf("%-8s %12s unsupported\n", kernel_names[k], shapes[s]);
+        continue;
+      }
+      for(int p = 0; p < percentage_amount; p++){
+        float frame_percentage = percentages[p]/100.0f;
+        // Pixels of the frame, the corners once
+        int64_t up_end = (int64_t)(height*frame_percentage);
+        int64_t left_end = (int64_t)(width*frame_percentage);
+        int64_t inner_width = width - 2*left_end > 0 ? width - 2*left_end : 0;
+        int64_t inner_height = height - 2*up_end > 0 ? height - 2*up_end : 0;
+        double frame_bytes = 4.0*((int64_t)width*height - inner_width*inner_height);
+
+        for(int method = SINGLE_PASS; method <= FOUR_BORDERS; method++){
+          // Warm up the caches, the branch predictors and the frequency of the processor
+          int64_t warm_up_end = getNanoseconds() + WARM_UP_NANOSECONDS;
+          do{
+            accumulateFrame(ctx, pixels, method, frame_percentage);
+          }while(getNanoseconds() < warm_up_end);
+
+          int64_t times[MAX_REPETITIONS];
+          uint64_t best_cycles = 0;
+          for(int r = 0; r < repetitions; r++){
+            uint64_t cycles = readCycles(counter);
+            int64_t start = getNanoseconds();
+            accumulateFrame(ctx, pixels, method, frame_percentage);
+            times[r] = getNanoseconds() - start;
+            cycles = readCycles(counter) - cycles;
+            if(r == 0 || cycles < best_cycles){
+              best_cycles = cycles;
+            }
+          }
+          qsort(times, repetitions, sizeof(int64_t), compareTimes);
+
+          char cycle_text[32] = "-";
+          char ratio_text[32] = "-";
+          if(counter >= 0 && best_cycles > 0){
+            snprintf(cycle_text, sizeof(cycle_text), "%llu", (unsigned long long)best_cycles);
+            snprintf(ratio_text, sizeof(ratio_text), "%.2f", frame_bytes/best_cycles);
+          }
+          printf("%-8s %12s %5g %-13s %12.1f %12.1f %12s %12s\n", kernel_names[k], shapes[s], percentages[p], method_names[method], times[repetitions/2]/1e3, times[0]/1e3, cycle_text, ratio_text);
+        }
+      }
+    }
+    free(pixels);
+  }
+
+  colorflow_ctx_destroy(ctx);
+  if(counter >= 0){
+    close(counter);
+  }
+  return 0;
+}
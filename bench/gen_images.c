@@ -0,0 +1,315 @@
+// Synthetic pictures for the benchmark suite, in every format and color type colorflow reads
+//
+// Build and run from the root of the repository:
+//
+//   make bench/gen_images
+//   ./bench/gen_images DIRECTORY [megapixels...]
+//
+// Each size gives one picture per variant, named after its size and variant, such as
+// DIRECTORY/12mp_png_rgba16.png. The pictures are 4:3, a gradient with some noise so that
+// they do not compress to nothing, and are written row by row: a 200 MP picture needs a
+// single row of memory. A picture that already exists is not written again.
+//
+// Variants: PNG with a palette, gray, RGBA and 16 bit RGBA, JPEG with 4:4:4, 4:2:2 and 4:2:0
+// chroma subsampling and gray, BMP with 24 and 32 bits per pixel.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <png.h>
+#include <jpeglib.h>
+
+// Variants written for every size
+#define PNG_PALETTE 0
+#define PNG_GRAY 1
+#define PNG_RGBA 2
+#define PNG_RGBA16 3
+#define JPEG_444 4
+#define JPEG_422 5
+#define JPEG_420 6
+#define JPEG_GRAY 7
+#define BMP_24 8
+#define BMP_32 9
+#define VARIANT_AMOUNT 10
+
+static const char *variant_names[VARIANT_AMOUNT] = {"png_palette", "png_gray", "png_rgba", "png_rgba16", "jpeg_444", "jpeg_422", "jpeg_420", "jpeg_gray", "bmp_24", "bmp_32"};
+static const char *variant_extensions[VARIANT_AMOUNT] = {"png", "png", "png", "png", "jpeg", "jpeg", "jpeg", "jpeg", "bmp", "bmp"};
+
+/// @brief color of a pixel of the synthetic picture, the same for every variant
+/// @param x column of the pixel
+/// @param y row of the pixel
+/// @param width width of the picture
+/// @param height height of the picture
+/// @param rgba pointer to store the red, green, blue and alpha values into, on 16 bits
+static void syntheticColor(int x, int y, int width, int height, uint16_t *rgba){
+  // A small hash of the position is the noise, so that any row can be computed on its own
+  uint32_t noise = (uint32_t)x*0x9E3779B1u ^ (uint32_t)y*0x85EBCA77u;
+  noise ^= noise >> 15;
+  noise *= 0x2C1B3C6Du;
+  noise ^= noise >> 12;
+  rgba[0] = (uint16_t)((uint64_t)x*0xF000/width + (noise & 0x0FFF));
+  rgba[1] = (uint16_t)((uint64_t)y*0xF000/height + (noise >> 12 & 0x0FFF));
+  rgba[2] = (uint16_t)((uint64_t)(x + y)*0xF000/(width + height) + (noise >> 20 & 0x0FFF));
+  rgba[3] = (uint16_t)(0xFFFF - (noise >> 24 & 0x3F)*0x100);
+}
+
+/// @brief write a PNG picture, one of the PNG variants
+/// @param path path of the picture
+/// @param variant PNG_PALETTE, PNG_GRAY, PNG_RGBA or PNG_RGBA16
+/// @param width width of the picture
+/// @param height height of the picture
+/// @return 0, or -1 if the picture could not be written
+static int writePNG(const char *path, int variant, int width, int height){
+  FILE *file = fopen(path, "wb");
+  if(!file){
+    return -1;
+  }
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = png ? png_create_info_struct(png) : NULL;
+  int channels = variant == PNG_RGBA || variant == PNG_RGBA16 ? 4 : 1;
+  int depth = variant == PNG_RGBA16 ? 16 : 8;
+  png_bytep row = (png_bytep)malloc((size_t)width*channels*depth/8);
+  if(!info || !row || setjmp(png_jmpbuf(png))){
+    png_destroy_write_struct(&png, &info);
+    free(row);
+    fclose(file);
+    return -1;
+  }
+  png_init_io(png, file);
+  // The benchmark reads the pictures, their size matters less than the time it takes to write them
+  png_set_compression_level(png, 1);
+
+  int color_type = variant == PNG_PALETTE ? PNG_COLOR_TYPE_PALETTE : variant == PNG_GRAY ? PNG_COLOR_TYPE_GRAY : PNG_COLOR_TYPE_RGBA;
+  png_set_IHDR(png, info, width, height, depth, color_type, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  if(variant == PNG_PALETTE){
+    // 16 levels of red times 16 levels of green
+    png_color palette[256];
+    for(int i = 0; i < 256; i++){
+      palette[i].red = (i & 0xF0) | 0x08;
+      palette[i].green = (i << 4 & 0xF0) | 0x08;
+      palette[i].blue = 0x80;
+    }
+    png_set_PLTE(png, info, palette, 256);
+  }
+  png_write_info(png, info);
+
+  uint16_t rgba[4];
+  for(int y = 0; y < height; y++){
+    for(int x = 0; x < width; x++){
+      syntheticColor(x, y, width, height, rgba);
+      switch(variant){
+        case PNG_PALETTE:
+          row[x] = (rgba[0] >> 8 & 0xF0) | rgba[1] >> 12;
+          break;
+        case PNG_GRAY:
+          row[x] = (uint8_t)(((uint32_t)rgba[0] + rgba[1] + rgba[2])/3 >> 8);
+          break;
+        case PNG_RGBA:
+          for(int c = 0; c < 4; c++){
+            row[4*x + c] = rgba[c] >> 8;
+          }
+          break;
+        default:
+          // 16 bit samples are big endian
+          for(int c = 0; c < 4; c++){
+            row[8*x + 2*c] = rgba[c] >> 8;
+            row[8*x + 2*c + 1] = rgba[c] & 0xFF;
+          }
+          break;
+      }
+    }
+    png_write_row(png, row);
+  }
+  png_write_end(png, NULL);
+  png_destroy_write_struct(&png, &info);
+  free(row);
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+/// @brief write a JPEG picture, one of the JPEG variants
+/// @param path path of the picture
+/// @param variant JPEG_444, JPEG_422, JPEG_420 or JPEG_GRAY
+/// @param width width of the picture
+/// @param height height of the picture
+/// @return 0, or -1 if the picture could not be written
+static int writeJPEG(const char *path, int variant, int width, int height){
+  FILE *file = fopen(path, "wb");
+  if(!file){
+    return -1;
+  }
+  int channels = variant == JPEG_GRAY ? 1 : 3;
+  JSAMPLE *row = (JSAMPLE*)malloc((size_t)width*channels);
+  if(!row){
+    fclose(file);
+    return -1;
+  }
+
+  // libjpeg exits on errors, which is enough for a generator
+  struct jpeg_compress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  jpeg_stdio_dest(&cinfo, file);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = channels;
+  cinfo.in_color_space = variant == JPEG_GRAY ? JCS_GRAYSCALE : JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, 90, TRUE);
+  if(variant != JPEG_GRAY){
+    // The chroma components keep one sample per luma sample, per pair of columns, or per 2x2 block
+    cinfo.comp_info[0].h_samp_factor = variant == JPEG_444 ? 1 : 2;
+    cinfo.comp_info[0].v_samp_factor = variant == JPEG_420 ? 2 : 1;
+  }
+  jpeg_start_compress(&cinfo, TRUE);
+
+  uint16_t rgba[4];
+  while(cinfo.next_scanline < cinfo.image_height){
+    int y = cinfo.next_scanline;
+    for(int x = 0; x < width; x++){
+      syntheticColor(x, y, width, height, rgba);
+      if(variant == JPEG_GRAY){
+        row[x] = (JSAMPLE)(((uint32_t)rgba[0] + rgba[1] + rgba[2])/3 >> 8);
+      }
+      else{
+        for(int c = 0; c < 3; c++){
+          row[3*x + c] = rgba[c] >> 8;
+        }
+      }
+    }
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  free(row);
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+/// @brief store a little endian value into a header
+/// @param bytes where to store the value
+/// @param value value to store
+/// @param size number of bytes of the value
+static void storeLittleEndian(unsigned char *bytes, uint32_t value, int size){
+  for(int i = 0; i < size; i++){
+    bytes[i] = value >> 8*i & 0xFF;
+  }
+}
+
+/// @brief write an uncompressed BMP picture, one of the BMP variants
+/// @param path path of the picture
+/// @param variant BMP_24 or BMP_32
+/// @param width width of the picture
+/// @param height height of the picture
+/// @return 0, or -1 if the picture could not be written
+static int writeBMP(const char *path, int variant, int width, int height){
+  int bytes_per_pixel = variant == BMP_32 ? 4 : 3;
+  // Rows are padded to 4 bytes
+  size_t stride = ((size_t)width*bytes_per_pixel + 3) & ~(size_t)3;
+  uint64_t file_size = 54 + (uint64_t)stride*height;
+  if(file_size > UINT32_MAX){
+    errno = EFBIG;
+    return -1;
+  }
+  FILE *file = fopen(path, "wb");
+  unsigned char *row = (unsigned char*)calloc(stride, 1);
+  if(!file || !row){
+    if(file){
+      fclose(file);
+    }
+    free(row);
+    return -1;
+  }
+
+  // BITMAPFILEHEADER then BITMAPINFOHEADER
+  unsigned char header[54];
+  memset(header, 0, sizeof(header));
+  header[0] = 'B';
+  header[1] = 'M';
+  storeLittleEndian(header + 2, (uint32_t)file_size, 4);
+  storeLittleEndian(header + 10, 54, 4);
+  storeLittleEndian(header + 14, 40, 4);
+  storeLittleEndian(header + 18, width, 4);
+  storeLittleEndian(header + 22, height, 4);
+  storeLittleEndian(header + 26, 1, 2);
+  storeLittleEndian(header + 28, 8*bytes_per_pixel, 2);
+  storeLittleEndian(header + 34, (uint32_t)(file_size - 54), 4);
+  fwrite(header, 1, sizeof(header), file);
+
+  // The rows are stored from the bottom of the picture, as BGR or BGRA
+  uint16_t rgba[4];
+  for(int k = 0; k < height; k++){
+    int y = height - 1 - k;
+    for(int x = 0; x < width; x++){
+      syntheticColor(x, y, width, height, rgba);
+      unsigned char *bytes = row + (size_t)x*bytes_per_pixel;
+      bytes[0] = rgba[2] >> 8;
+      bytes[1] = rgba[1] >> 8;
+      bytes[2] = rgba[0] >> 8;
+      if(bytes_per_pixel == 4){
+        bytes[3] = rgba[3] >> 8;
+      }
+    }
+    fwrite(row, 1, stride, file);
+  }
+  free(row);
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+int main(int argc, char *argv[]){
+  if(argc < 2){
+    fprintf(stderr, "Usage: %s DIRECTORY [megapixels...]\n", argv[0]);
+    return 1;
+  }
+  const char *directory = argv[1];
+  if(mkdir(directory, 0755) != 0 && errno != EEXIST){
+    perror(directory);
+    return 1;
+  }
+
+  const char *default_sizes[] = {"1", "12"};
+  int size_amount = argc > 2 ? argc - 2 : 2;
+  const char **sizes = argc > 2 ? (const char**)argv + 2 : default_sizes;
+
+  for(int s = 0; s < size_amount; s++){
+    double megapixels = atof(sizes[s]);
+    if(megapixels <= 0 || megapixels > 1000){
+      fprintf(stderr, "Error: %s is not a number of megapixels\n", sizes[s]);
+      return 1;
+    }
+    int width = (int)lround(sqrt(megapixels*1e6*4/3));
+    int height = (int)lround(megapixels*1e6/width);
+
+    for(int v = 0; v < VARIANT_AMOUNT; v++){
+      char path[4096];
+      snprintf(path, sizeof(path), "%s/%smp_%s.%s", directory, sizes[s], variant_names[v], variant_extensions[v]);
+      struct stat info;
+      if(stat(path, &info) == 0){
+        continue;
+      }
+      // The picture gets its name once it is complete, an interrupted run leaves no truncated picture behind
+      char partial_path[4200];
+      snprintf(partial_path, sizeof(partial_path), "%s.partial", path);
+      int failed;
+      if(v <= PNG_RGBA16){
+        failed = writePNG(partial_path, v, width, height);
+      }
+      else if(v <= JPEG_GRAY){
+        failed = writeJPEG(partial_path, v, width, height);
+      }
+      else{
+        failed = writeBMP(partial_path, v, width, height);
+      }
+      if(failed || rename(partial_path, path) != 0){
+        perror(path);
+        remove(partial_path);
+        return 1;
+      }
+      printf("%s %dx%d\n", path, width, height);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,198 @@
+// Throughput and peak memory of colorflow on pictures, per picture and per format
+//
+// Build and run from the root of the repository:
+//
+//   make bench/image_bench
+//   ./bench/image_bench [-r runs] [-n frame_percentage] [-c colorflow] FILE...
+//
+// Every picture is computed once by libcolorflow to get its dimensions and warm the page
+// cache, then colorflow is run on it runs times in a process of its own. The best wall
+// time gives MP/s and ns/pixel, and the peak RSS is the largest one of the runs, read
+// from wait4. The output has no timestamp or path of the machine, so that two runs of the
+// suite can be compared line by line.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "../include/colorflow.h"
+
+#define FORMAT_AMOUNT 3
+
+static const char *format_names[FORMAT_AMOUNT] = {"png", "jpeg", "bmp"};
+
+// Totals of the pictures of a format
+typedef struct{
+  int file_amount;
+  double megapixels;
+  int64_t nanoseconds;    // sum of the best times of the pictures
+  long peak_rss;          // in kilobytes
+} format_total;
+
+/// @brief time of a monotonic clock
+/// @return time in nanoseconds
+static int64_t getNanoseconds(void){
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (int64_t)time.tv_sec*1000000000 + time.tv_nsec;
+}
+
+/// @brief run colorflow on a picture in a new process, its output is discarded
+/// @param colorflow path of the colorflow program
+/// @param percentage frame percentage given to -n
+/// @param filename picture to compute
+/// @param peak_rss pointer to store the peak resident memory of the process into, in kilobytes
+/// @return wall time of the process in nanoseconds, or -1 if it failed
+static int64_t runColorflow(const char *colorflow, const char *percentage, const char *filename, long *peak_rss){
+  int64_t start = getNanoseconds();
+  pid_t pid = fork();
+  if(pid < 0){
+    return -1;
+  }
+  if(pid == 0){
+    int null = open("/dev/null", O_WRONLY);
+    if(null >= 0){
+      dup2(null, STDOUT_FILENO);
+    }
+    execl(colorflow, colorflow, "-n", percentage, "-f", filename, (char*)NULL);
+    _exit(127);
+  }
+  int status;
+  struct rusage usage;
+  if(wait4(pid, &status, 0, &usage) != pid){
+    return -1;
+  }
+  int64_t time = getNanoseconds() - start;
+  *peak_rss = usage.ru_maxrss;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? time : -1;
+}
+
+/// @brief format of a picture, from its signature
+/// @param filename picture
+/// @return index in format_names, or -1 for an unknown format
+static int readFormat(const char *filename){
+  unsigned char signature[3] = {0, 0, 0};
+  FILE *file = fopen(filename, "rb");
+  if(!file){
+    return -1;
+  }
+  size_t length = fread(signature, 1, sizeof(signature), file);
+  fclose(file);
+  if(length < 2){
+    return -1;
+  }
+  if(signature[0] == 0x89 && signature[1] == 'P'){
+    return 0;
+  }
+  if(signature[0] == 0xFF && signature[1] == 0xD8){
+    return 1;
+  }
+  if(signature[0] == 'B' && signature[1] == 'M'){
+    return 2;
+  }
+  return -1;
+}
+
+int main(int argc, char *argv[]){
+  int runs = 3;
+  const char *percentage = "10";
+  const char *colorflow = "./colorflow";
+  int opt;
+  while((opt = getopt(argc, argv, "r:n:c:")) != -1){
+    switch(opt){
+      case 'r':
+        runs = atoi(optarg);
+        break;
+      case 'n':
+        percentage = optarg;
+        break;
+      case 'c':
+        colorflow = optarg;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-r runs] [-n frame_percentage] [-c colorflow] FILE...\n", argv[0]);
+        return 1;
+    }
+  }
+  if(optind == argc || runs < 1){
+    fprintf(stderr, "Usage: %s [-r runs] [-n frame_percentage] [-c colorflow] FILE...\n", argv[0]);
+    return 1;
+  }
+
+  colorflow_ctx *ctx = colorflow_ctx_create();
+  if(!ctx){
+    fprintf(stderr,"Error while allowing memory.\n");
+    return 1;
+  }
+  colorflow_options options;
+  memset(&options, 0, sizeof(options));
+  // The library takes the frame percentage as a fraction of the picture
+  options.frame_percentage = (float)(atof(percentage)/100.0);
+  format_total totals[FORMAT_AMOUNT];
+  memset(totals, 0, sizeof(totals));
+  int exit_code = 0;
+
+  printf("# colorflow bench, frame %s%%, best of %d runs\n", percentage, runs);
+  printf("%-28s %-6s %6s %6s %8s %10s %9s %9s %12s\n", "file", "format", "width", "height", "MP", "best ms", "MP/s", "ns/pixel", "peak RSS KB");
+  for(int i = optind; i < argc; i++){
+    // The names of the pictures, not their directories, keep the output the same from one machine to the next
+    char *name = basename(argv[i]);
+    int format = readFormat(argv[i]);
+    colorflow_result result;
+    if(format < 0 || colorflow_compute(ctx, argv[i], &options, &result) != COLORFLOW_OK){
+      printf("%-28s failed\n", name);
+      exit_code = 1;
+      continue;
+    }
+
+    int64_t best = -1;
+    long peak_rss = 0;
+    for(int r = 0; r < runs; r++){
+      long rss = 0;
+      int64_t time = runColorflow(colorflow, percentage, argv[i], &rss);
+      if(time < 0){
+        best = -1;
+        break;
+      }
+      if(best < 0 || time < best){
+        best = time;
+      }
+      if(rss > peak_rss){
+        peak_rss = rss;
+      }
+    }
+    if(best < 0){
+      printf("%-28s failed\n", name);
+      exit_code = 1;
+      continue;
+    }
+
+    double megapixels = (double)result.width*result.height/1e6;
+    printf("%-28s %-6s %6d %6d %8.2f %10.2f %9.1f %9.2f %12ld\n", name, format_names[format], result.width, result.height, megapixels, best/1e6, megapixels*1e9/best, best/(megapixels*1e6), peak_rss);
+    fflush(stdout);
+    totals[format].file_amount++;
+    totals[format].megapixels += megapixels;
+    totals[format].nanoseconds += best;
+    if(peak_rss > totals[format].peak_rss){
+      totals[format].peak_rss = peak_rss;
+    }
+  }
+
+  printf("\n%-6s %5s %10s %10s %9s %9s %12s\n", "format", "files", "MP", "total ms", "MP/s", "ns/pixel", "peak RSS KB");
+  for(int f = 0; f < FORMAT_AMOUNT; f++){
+    format_total *total = &totals[f];
+    if(total->file_amount == 0){
+      continue;
+    }
+    printf("%-6s %5d %10.2f %10.2f %9.1f %9.2f %12ld\n", format_names[f], total->file_amount, total->megapixels, total->nanoseconds/1e6, total->megapixels*1e9/total->nanoseconds, total->nanoseconds/(total->megapixels*1e6), total->peak_rss);
+  }
+  colorflow_ctx_destroy(ctx);
+  return exit_code;
+}
@@ -0,0 +1,44 @@
+#!/bin/bash
+
+# Compare the time colorflow takes on big JPEG pictures with a reference build,
+# for instance one built from the commit before the frame-aware JPEG decoder:
+#
+#   git show <commit>:colorflow.c > /tmp/colorflow_ref.c
+#   gcc /tmp/colorflow_ref.c -o /tmp/colorflow_ref -Wall -lpng -ljpeg include/libnsbmp.c
+#   ./bench/jpeg_frame.sh /tmp/colorflow_ref pictures/mountain.jpeg other.jpeg
+#
+# Usage: ./bench/jpeg_frame.sh REFERENCE_BINARY [JPEG files...]
+
+REFERENCE=$1
+shift
+IMAGES=${@:-./pictures/mountain.jpeg}
+RUNS=${RUNS:-5}
+PERCENTAGES=${PERCENTAGES:-"10 25"}
+
+if [ ! -x "$REFERENCE" ] || [ ! -x ./colorflow ]; then
+    echo "Usage: $0 REFERENCE_BINARY [JPEG files...]"
+    echo "(run it from the root of the repository after make)"
+    exit 1
+fi
+
+# Best wall time in milliseconds of RUNS executions of a command
+best_time() {
+    BEST=""
+    for RUN in $(seq $RUNS); do
+        START=$EPOCHREALTIME
+        "$@" > /dev/null || return 1
+        END=$EPOCHREALTIME
+        BEST=$(awk -v s=$START -v e=$END -v b="$BEST" 'BEGIN { t = (e - s) * 1000; if (b == "" || t < b) b = t; print b }')
+    done
+    printf "%.1f" $BEST
+}
+
+printf "%-40s %4s %14s %14s %8s\n" "file" "-n" "reference ms" "colorflow ms" "speedup"
+for IMAGE_FILE in $IMAGES; do
+    for PERCENTAGE in $PERCENTAGES; do
+        REFERENCE_TIME=$(best_time $REFERENCE -f $IMAGE_FILE -n $PERCENTAGE)
+        COLORFLOW_TIME=$(best_time ./colorflow -f $IMAGE_FILE -n $PERCENTAGE)
+        SPEEDUP=$(awk -v r=$REFERENCE_TIME -v c=$COLORFLOW_TIME 'BEGIN { printf "%.2f", r / c }')
+        printf "%-40s %4s %14s %14s %7sx\n" $IMAGE_FILE $PERCENTAGE $REFERENCE_TIME $COLORFLOW_TIME $SPEEDUP
+    done
+done
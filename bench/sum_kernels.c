@@ -0,0 +1,86 @@
+// Throughput of the row summing kernels of libcolorflow, in bytes per cycle
+//
+// Build and run from the root of the repository:
+//
+//   make bench/sum_kernels
+//   ./bench/sum_kernels [widths...]
+//
+// Cycles are read with rdtsc, so they are reference cycles: with turbo the
+// figures are a bit optimistic compared with core cycles.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <x86intrin.h>
+#include "../include/colorflow.h"
+
+#define TRIALS 7
+#define BYTES_PER_TRIAL (64 * 1024 * 1024)
+
+static volatile int64_t sink;
+
+static const char *kernel_names[] = {"scalar", "sse2", "avx2", "avx512"};
+
+int main(int argc, char *argv[]){
+  int default_widths[] = {64, 1920, 8000, 100000};
+  int width_amount = argc > 1 ? argc - 1 : 4;
+  int *widths = default_widths;
+  if(argc > 1){
+    widths = (int*)malloc(width_amount*sizeof(int));
+    for(int i=0; i<width_amount; i++){
+      widths[i] = atoi(argv[i+1]);
+    }
+  }
+
+  printf("%-8s %8s %12s\n", "kernel", "width", "bytes/cycle");
+  for(int w=0; w<width_amount; w++){
+    int width = widths[w];
+    pixel *row = (pixel*)malloc(width*sizeof(pixel));
+    if(!row){
+      return 1;
+    }
+    srand(width);
+    for(int x=0; x<width; x++){
+      row[x] = createPixel(rand(), rand(), rand(), rand());
+    }
+    int repetitions = BYTES_PER_TRIAL/(width*sizeof(pixel)) + 1;
+
+    int64_t reference[4] = {0,0,0,0};
+    selectSumKernel("scalar");
+    sumRow(reference, row, 0, width);
+
+    for(int k=0; k<(int)(sizeof(kernel_names)/sizeof(kernel_names[0])); k++){
+      if(selectSumKernel(kernel_names[k])){
+        printf("%-8s %8d %12s\n", kernel_names[k], width, "unsupported");
+        continue;
+      }
+
+      int64_t check[4] = {0,0,0,0};
+      sumRow(check, row, 0, width);
+      for(int i=0; i<4; i++){
+        if(check[i] != reference[i]){
+          printf("%-8s %8d wrong sums\n", kernel_names[k], width);
+          return 1;
+        }
+      }
+
+      // Best of TRIALS, the sums go to sink so the loop is not removed
+      unsigned long long best = 0;
+      int64_t sums[4] = {0,0,0,0};
+      for(int t=0; t<TRIALS; t++){
+        unsigned long long start = __rdtsc();
+        for(int r=0; r<repetitions; r++){
+          sumRow(sums, row, 0, width);
+        }
+        unsigned long long cycles = __rdtsc() - start;
+        if(t == 0 || cycles < best){
+          best = cycles;
+        }
+      }
+      double bytes = (double)repetitions*width*sizeof(pixel);
+      sink += sums[0];
+      printf("%-8s %8d %12.2f\n", kernel_names[k], width, bytes/best);
+    }
+    free(row);
+  }
+  return 0;
+}
@@ -0,0 +1,265 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "include/cache.h"
+
+// Version 1 of the file, the layout of the header and of the entries must not change without changing the magic
+#define CACHE_MAGIC "CFCACHE1"
+// Entries of a new cache file, 4 MB
+#define CACHE_ENTRIES 65536
+// Entries looked at from the slot of a key, the last one is replaced when they are all taken
+#define CACHE_PROBES 8
+
+struct cache_header{
+  char magic[8];
+  uint32_t entry_amount;
+  uint32_t entry_size;
+  unsigned char padding[48];
+};
+
+// One entry per cache line, check is 0 for an empty entry and the hash of the other fields otherwise
+struct cache_entry{
+  cache_key key;
+  int32_t width;
+  int32_t height;
+  uint8_t average_RGBA[4];
+  uint32_t padding;
+  uint64_t check;
+};
+
+/// @brief mix the bits of a 64 bit value, the finalizer of splitmix64
+/// @param value value to mix
+/// @return mixed value
+static uint64_t mix64(uint64_t value){
+  value ^= value >> 30;
+  value *= 0xbf58476d1ce4e5b9ULL;
+  value ^= value >> 27;
+  value *= 0x94d049bb133111ebULL;
+  value ^= value >> 31;
+  return value;
+}
+
+/// @brief hash of an array of 64 bit words
+/// @param words words to hash
+/// @param amount number of words
+/// @return hash, never 0
+static uint64_t hashWords(const uint64_t *words, size_t amount){
+  uint64_t hash = 0x9e3779b97f4a7c15ULL;
+  for(size_t i = 0; i < amount; i++){
+    hash = mix64(hash ^ words[i]);
+  }
+  return hash ? hash : 1;
+}
+
+/// @brief hash of the file and the computation of a key, which gives its first slot
+/// @param key key to hash
+/// @return hash of the key without its size and modification time, so that every version of a file probes the same entries
+static uint64_t hashKey(const cache_key *key){
+  uint64_t words[3] = {key->device, key->inode, 0};
+  memcpy(&words[2], &key->frame_percentage, sizeof(float));
+  memcpy((char*)&words[2] + sizeof(float), &key->mode, sizeof(uint32_t));
+  return hashWords(words, 3);
+}
+
+/// @brief hash of every field of an entry but its check
+/// @param entry entry to hash
+/// @return hash of the entry, never 0
+static uint64_t hashEntry(const struct cache_entry *entry){
+  return hashWords((const uint64_t*)entry, offsetof(struct cache_entry, check)/sizeof(uint64_t));
+}
+
+/// @brief check whether two keys are the same computation of the same file, whatever its version
+/// @param a first key
+/// @param b second key
+/// @return 1 when they are, 0 otherwise
+static int sameFile(const cache_key *a, const cache_key *b){
+  return a->device == b->device && a->inode == b->inode && a->frame_percentage == b->frame_percentage && a->mode == b->mode;
+}
+
+/// @brief check whether two keys are the same
+/// @param a first key
+/// @param b second key
+/// @return 1 when they are the same, 0 otherwise
+static int sameKey(const cache_key *a, const cache_key *b){
+  return memcmp(a, b, sizeof(cache_key)) == 0;
+}
+
+/// @brief open the cache file path, which is created when it does not exist
+/// @param cache cache to open
+/// @param path path of the cache file
+/// @return 0, or -1 with errno set if the file could not be opened or is not a cache file
+int openCache(result_cache *cache, const char *path){
+  memset(cache, 0, sizeof(result_cache));
+  cache->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if(cache->fd < 0){
+    return -1;
+  }
+
+  // The first process that opens the file sets its size and its header, the others wait for it
+  size_t size = sizeof(struct cache_header) + (size_t)CACHE_ENTRIES*sizeof(struct cache_entry);
+  struct stat info;
+  if(flock(cache->fd, LOCK_EX) != 0 || fstat(cache->fd, &info) != 0){
+    close(cache->fd);
+    return -1;
+  }
+  if(info.st_size == 0){
+    struct cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.entry_amount = CACHE_ENTRIES;
+    header.entry_size = sizeof(struct cache_entry);
+    if(ftruncate(cache->fd, size) != 0 || pwrite(cache->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)){
+      flock(cache->fd, LOCK_UN);
+      close(cache->fd);
+      return -1;
+    }
+  }
+  else{
+    // A file made by another version may have another number of entries
+    struct cache_header header;
+    if(pread(cache->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0
+       || header.entry_size != sizeof(struct cache_entry) || header.entry_amount == 0
+       || (size_t)info.st_size != sizeof(struct cache_header) + (size_t)header.entry_amount*sizeof(struct cache_entry)){
+      flock(cache->fd, LOCK_UN);
+      close(cache->fd);
+      errno = EINVAL;
+      return -1;
+    }
+    size = info.st_size;
+  }
+  flock(cache->fd, LOCK_UN);
+
+  void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, cache->fd, 0);
+  if(map == MAP_FAILED){
+    close(cache->fd);
+    return -1;
+  }
+  cache->header = (struct cache_header*)map;
+  cache->entries = (struct cache_entry*)(cache->header + 1);
+  cache->entry_amount = cache->header->entry_amount;
+  pthread_mutex_init(&cache->write_lock, NULL);
+  return 0;
+}
+
+/// @brief fill a key with the identity of a file
+/// @param key key to fill
+/// @param path path of the file
+/// @param frame_percentage frame percentage of the color
+/// @param mode options that change the colors
+/// @return 0, or -1 if the file could not be read
+int getCacheKey(cache_key *key, const char *path, float frame_percentage, uint32_t mode){
+  struct stat info;
+  if(stat(path, &info) != 0){
+    return -1;
+  }
+  // Keys are hashed and compared as raw bytes
+  memset(key, 0, sizeof(cache_key));
+  key->device = info.st_dev;
+  key->inode = info.st_ino;
+  key->size = info.st_size;
+  key->mtime_ns = (uint64_t)info.st_mtim.tv_sec*1000000000 + info.st_mtim.tv_nsec;
+  key->frame_percentage = frame_percentage;
+  key->mode = mode;
+  return 0;
+}
+
+/// @brief look up a color in the cache, without taking any lock
+/// @param cache opened cache
+/// @param key key of the color
+/// @param width width of the picture, set on a hit
+/// @param height height of the picture, set on a hit
+/// @param average_RGBA array we want to store the color into on a hit
+/// @return 1 on a hit, 0 on a miss
+int lookupCache(result_cache *cache, const cache_key *key, int *width, int *height, int *average_RGBA){
+  uint64_t slot = hashKey(key) % cache->entry_amount;
+  for(int probe = 0; probe < CACHE_PROBES; probe++){
+    struct cache_entry *shared = &cache->entries[(slot + probe) % cache->entry_amount];
+
+    // The entry is copied then checked, a copy torn by a writer of another thread or process does not match its check
+    uint64_t check = __atomic_load_n(&shared->check, __ATOMIC_ACQUIRE);
+    if(check == 0){
+      break;
+    }
+    struct cache_entry entry;
+    memcpy(&entry, shared, sizeof(entry));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&shared->check, __ATOMIC_RELAXED) != check || hashEntry(&entry) != check){
+      continue;
+    }
+
+    // The entry of an older version of the file is a miss, and is replaced by storeCache
+    if(sameFile(&entry.key, key)){
+      if(!sameKey(&entry.key, key)){
+        break;
+      }
+      *width = entry.width;
+      *height = entry.height;
+      for(int i = 0; i < 4; i++){
+        average_RGBA[i] = entry.average_RGBA[i];
+      }
+      __atomic_fetch_add(&cache->hits, 1, __ATOMIC_RELAXED);
+      return 1;
+    }
+  }
+  __atomic_fetch_add(&cache->misses, 1, __ATOMIC_RELAXED);
+  return 0;
+}
+
+/// @brief store a color in the cache, the entry of an older version of the file is replaced
+/// @param cache opened cache
+/// @param key key of the color
+/// @param width width of the picture
+/// @param height height of the picture
+/// @param average_RGBA color to store
+void storeCache(result_cache *cache, const cache_key *key, int width, int height, const int *average_RGBA){
+  struct cache_entry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.key = *key;
+  entry.width = width;
+  entry.height = height;
+  for(int i = 0; i < 4; i++){
+    entry.average_RGBA[i] = (uint8_t)average_RGBA[i];
+  }
+  entry.check = hashEntry(&entry);
+
+  pthread_mutex_lock(&cache->write_lock);
+  if(flock(cache->fd, LOCK_EX) != 0){
+    pthread_mutex_unlock(&cache->write_lock);
+    return;
+  }
+
+  // First empty entry, or an entry of the same computation of the same file, or the last probed one
+  uint64_t slot = hashKey(key) % cache->entry_amount;
+  struct cache_entry *target = NULL;
+  for(int probe = 0; probe < CACHE_PROBES && !target; probe++){
+    struct cache_entry *shared = &cache->entries[(slot + probe) % cache->entry_amount];
+    if(shared->check == 0 || sameFile(&shared->key, key)){
+      target = shared;
+    }
+  }
+  if(!target){
+    target = &cache->entries[(slot + CACHE_PROBES - 1) % cache->entry_amount];
+  }
+
+  // Readers see either no entry or the whole new one
+  __atomic_store_n(&target->check, 0, __ATOMIC_RELEASE);
+  memcpy(target, &entry, offsetof(struct cache_entry, check));
+  __atomic_store_n(&target->check, entry.check, __ATOMIC_RELEASE);
+
+  flock(cache->fd, LOCK_UN);
+  pthread_mutex_unlock(&cache->write_lock);
+}
+
+/// @brief unmap and close a cache
+/// @param cache opened cache
+void closeCache(result_cache *cache){
+  munmap(cache->header, sizeof(struct cache_header) + (size_t)cache->entry_amount*sizeof(struct cache_entry));
+  close(cache->fd);
+  pthread_mutex_destroy(&cache->write_lock);
+}
@@ -1,482 +1,1484 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <getopt.h>
-#include <assert.h>
+#include <time.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
-#include "include/png.h"
-#include "include/jpeglib.h"
-#include "include/libnsbmp.h"
 #include "include/colorflow.h"
-
-
-#define EXIT_FAILURE_OPEN_FAILED 1
-#define EXIT_FAILURE_BAD_FILE 2
-#define EXIT_FAILURE_USUPPORTED_FILE_FORMAT 3
-#define EXIT_FAILURE_MALLOC 4
-#define EXIT_FAILURE_BAD_PERCENTAGE 5
+#include "include/scheduler.h"
+#include "include/cache.h"
+#include "include/hash.h"
+#include "include/server.h"
+#include "include/trace.h"
+
+
+#define EXIT_FAILURE_OPEN_FAILED COLORFLOW_ERROR_OPEN_FAILED
+#define EXIT_FAILURE_BAD_FILE COLORFLOW_ERROR_BAD_FILE
+#define EXIT_FAILURE_USUPPORTED_FILE_FORMAT COLORFLOW_ERROR_UNSUPPORTED_FILE_FORMAT
+#define EXIT_FAILURE_MALLOC COLORFLOW_ERROR_MALLOC
+#define EXIT_FAILURE_BAD_PERCENTAGE COLORFLOW_ERROR_BAD_PERCENTAGE
 #define EXIT_FAILURE_UNKNOWN_OPTION 6
 #define EXIT_FAILURE_NEEDS_ARGUMENT 7
-
-// Initialization of global variables
-int width, height;
-size_t size;
-
-// Variable to check if debug mode is enabled or not
-int debug_mode = 0;
+#define EXIT_FAILURE_BAD_ZONES COLORFLOW_ERROR_BAD_ZONES
+#define EXIT_FAILURE_MEMORY_BUDGET COLORFLOW_ERROR_MEMORY_BUDGET
 
 void displayDebugInfo(char* debugInfo){
   printf("%s\n", debugInfo);
 }
 
-/// @param r Red component
-/// @param g Green component
-/// @param b Blue component
-/// @param a Alpha component
-/// @return new created pixel with the specified RGBA values
-pixel createPixel(unsigned char r, unsigned char g, unsigned char b, unsigned char a){
-  pixel p;
-  p.red = r;
-  p.green = g;
-  p.blue = b;
-  p.alpha = a;
-  return p;
-}
-
-/// @brief read a png file and store the RGBA values of each pixel in a matrix
-/// @param file binary file of a png picture
-/// @return matrix of pixels that contains the RGBA values of each pixel
-/// @author code from https://gist.github.com/niw/5963798
-pixel** read_png_file(FILE *file) {
-  
+/// @brief displays help message to the user
+/// @param debug_mode print the called function if enabled
+void displayHelp(int debug_mode){
+
   if(debug_mode){
-    displayDebugInfo("pixel** read_png_file(FILE *file)");
+    displayDebugInfo("void displayHelp(int debug_mode)");
   }
 
-  png_byte color_type;
-  png_byte bit_depth;
-  png_bytep *row_pointers = NULL;
-
-  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-  if(!png) abort();
+  char* filename = "help.txt";
+  FILE *file = fopen(filename, "rt");
+  if(!file){
+    fprintf(stderr,"Error while opening file %s\n", filename);
+    perror("open");
+    exit(EXIT_FAILURE_OPEN_FAILED);
+  }
+  char c;
+  while((c=fgetc(file))!=EOF){
+    printf("%c",c);
+  }
+  fclose(file);
+}
 
-  png_infop info = png_create_info_struct(png);
-  if(!info) abort();
+/// @brief displays the error returned by libcolorflow for a file
+/// @param filename name of the file
+/// @param code error code returned by libcolorflow
+void displayError(char* filename, int code){
+  switch(code){
+    case EXIT_FAILURE_OPEN_FAILED:
+      fprintf(stderr,"Error while opening file %s\n", filename);
+      perror("open");
+      break;
+    case EXIT_FAILURE_BAD_FILE:
+      fprintf(stderr,"Error while reading file %s\n", filename);
+      break;
+    case EXIT_FAILURE_USUPPORTED_FILE_FORMAT:
+      printf("Unsupported file format.\n");
+      break;
+    case EXIT_FAILURE_MALLOC:
+      fprintf(stderr,"Error while allowing memory.\n");
+      break;
+    case EXIT_FAILURE_BAD_PERCENTAGE:
+      fprintf(stderr,"Error : frame_percentage must be a value between 0 and 100\n");
+      break;
+    case EXIT_FAILURE_MEMORY_BUDGET:
+      fprintf(stderr,"Error : file %s needs more memory than the memory budget\n", filename);
+      break;
+    case EXIT_FAILURE_BAD_ZONES:
+      fprintf(stderr,"Error : zones must be given as TOPxSIDE with TOP and SIDE greater than 0, with a single frame_percentage\n");
+      break;
+  }
+}
 
-  if(setjmp(png_jmpbuf(png))) abort();
 
-  png_init_io(png, file);
+// Frame percentages given to -n, one color is displayed for each of them
+typedef struct{
+  int amount;
+  int *numbers;           // percentages as given on the command line
+  float *values;          // same percentages in ]0, 1]
+} percentage_list;
+
+// Zones of the frame given to --zones, the colors of all the zones of a file are displayed on one line
+typedef struct{
+  int top_amount;         // zones of the upper and lower borders, 0 without --zones
+  int side_amount;        // zones of the left and right borders
+} zone_layout;
+
+// Formats of the stage times displayed by --profile
+#define PROFILE_TEXT 1
+#define PROFILE_JSON 2
+
+// Spans kept by each worker with --trace, the oldest ones are lost beyond them
+#define TRACE_CAPACITY 65536
+
+// Stage times of the files computed with --profile, displayed on the error output for each file and for the whole run
+// With --trace, the stages of each file are also added to the trace of the worker that computed it
+typedef struct{
+  int format;               // PROFILE_TEXT or PROFILE_JSON, 0 to only trace the files
+  int file_amount;          // number of files displayed
+  colorflow_profile total;  // stages of every file displayed
+  int64_t start;            // time the run started at, in nanoseconds
+  trace_recorder *trace;    // NULL without --trace
+} profile_report;
+
+// Names of the stages, in the order of the COLORFLOW_STAGE values
+const char *stage_names[COLORFLOW_STAGE_AMOUNT] = {"open", "sniff", "header", "scanlines", "repack", "accumulate", "output"};
+
+// Result of the computation of one file
+typedef struct{
+  char* filename;
+  int code;               // error code returned by libcolorflow
+  int error_number;       // errno of the thread that opened the file
+  colorflow_result *results;  // one result per frame percentage
+  int *zone_RGBA;         // colors of the zones, clockwise from the top left corner
+  int done;               // set under the output lock of the batch
+  int hashed;             // the content of the file has been hashed by --dedup
+  uint64_t content_hash;
+  uint64_t content_size;
+  int next_duplicate;     // next job whose file has the same content, which takes the results of this one, -1 for none
+  int sampled;            // the frame is sampled, the standard errors of the colors are displayed with them
+  colorflow_profile profile;  // stages of the computation with --profile or --trace
+} file_job;
+
+// State shared by the workers of a multithreaded run
+typedef struct{
+  file_job *jobs;
+  int job_amount;
+  colorflow_ctx **contexts;   // one context per worker
+  colorflow_options *options;
+  percentage_list *percentages;
+  zone_layout *zones;
+  result_cache *cache;        // NULL without --cache
+  int *leaders;               // jobs computed by the workers, the others are duplicates of them, NULL to compute every job
+  int batch_mode;
+  int unordered;              // display the results as soon as they are computed
+  int next_output;            // first job whose result has not been displayed
+  profile_report *report;     // NULL without --profile and --trace
+  pthread_mutex_t output_lock;
+} file_batch;
+
+/// @brief read the frame percentages given to -n, a list separated by commas or all of them
+/// @param argument argument of -n
+/// @param percentages list we want to store the percentages into
+void parsePercentages(char* argument, percentage_list *percentages){
+  int capacity = 1;
+  for(char* c = argument; *c; c++){
+    capacity += *c == ',';
+  }
+  int all = strcmp(argument, "all") == 0;
+  if(all){
+    capacity = 100;
+  }
 
-  png_read_info(png, info);
+  free(percentages->numbers);
+  free(percentages->values);
+  percentages->numbers = (int*)malloc(capacity*sizeof(int));
+  percentages->values = (float*)malloc(capacity*sizeof(float));
+  if(!percentages->numbers || !percentages->values){
+    displayError(NULL, EXIT_FAILURE_MALLOC);
+    exit(EXIT_FAILURE_MALLOC);
+  }
 
-  width      = png_get_image_width(png, info);
-  height     = png_get_image_height(png, info);
-  color_type = png_get_color_type(png, info);
-  bit_depth  = png_get_bit_depth(png, info);
+  percentages->amount = 0;
+  char* number = argument;
+  for(int i = 0; i < capacity; i++){
+    int percentage = all ? i + 1 : atoi(number);
+    percentages->numbers[i] = percentage;
+    percentages->values[i] = (float)(percentage/100.0);
+    if(percentages->values[i] > 1.0 || percentages->values[i] <= 0.0){
+      displayError(NULL, EXIT_FAILURE_BAD_PERCENTAGE);
+      exit(EXIT_FAILURE_BAD_PERCENTAGE);
+    }
+    percentages->amount++;
+    // The last number has no comma after it
+    char *comma = all ? NULL : strchr(number, ',');
+    if(comma){
+      number = comma + 1;
+    }
+  }
+}
 
-  // Read any color_type into 8bit depth, RGBA format.
-  // See http://www.libpng.org/pub/png/libpng-manual.txt
+/// @brief read the zones given to --zones
+/// @param argument argument of --zones, TOPxSIDE
+/// @param zones layout we want to store the number of zones into
+void parseZones(char* argument, zone_layout *zones){
+  char end;
+  if(sscanf(argument, "%dx%d%c", &zones->top_amount, &zones->side_amount, &end) != 2 || zones->top_amount <= 0 || zones->side_amount <= 0){
+    displayError(NULL, EXIT_FAILURE_BAD_ZONES);
+    exit(EXIT_FAILURE_BAD_ZONES);
+  }
+}
 
-  if(bit_depth == 16)
-    png_set_strip_16(png);
+/// @brief number of zones around the frame
+/// @param zones layout of the zones
+/// @return number of colors displayed for a file, 0 without --zones
+int zoneAmount(zone_layout *zones){
+  return 2*zones->top_amount + 2*zones->side_amount;
+}
 
-  if(color_type == PNG_COLOR_TYPE_PALETTE)
-    png_set_palette_to_rgb(png);
+/// @brief compute the average colors of the frames of a file, unless the cache holds all of them
+/// @param ctx context reused from one file to the next
+/// @param job file to compute, its results are stored in it
+/// @param options options of the computation
+/// @param percentages frame percentages, the file is decoded once for all of them
+/// @param cache result cache, the computed colors are stored into it
+void computeCachedFile(colorflow_ctx *ctx, file_job *job, colorflow_options *options, percentage_list *percentages, result_cache *cache){
+  // The JPEG approximation is the only option that changes the colors of a file
+  cache_key key;
+  int identified = getCacheKey(&key, job->filename, 0, (uint32_t)options->fast_jpeg) == 0;
+  if(identified){
+    int hits = 0;
+    for(int i = 0; i < percentages->amount; i++){
+      key.frame_percentage = percentages->values[i];
+      hits += lookupCache(cache, &key, &job->results[i].width, &job->results[i].height, job->results[i].average_RGBA);
+    }
+    if(hits == percentages->amount){
+      job->code = COLORFLOW_OK;
+      return;
+    }
+  }
 
-  // PNG_COLOR_TYPE_GRAY_ALPHA is always 8 or 16bit depth.
-  if(color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
-    png_set_expand_gray_1_2_4_to_8(png);
+  job->code = colorflow_compute_percentages(ctx, job->filename, options, percentages->values, percentages->amount, job->results);
+  job->error_number = errno;
 
-  if(png_get_valid(png, info, PNG_INFO_tRNS))
-    png_set_tRNS_to_alpha(png);
+  // The colors are only stored when the file has not been modified while it was decoded
+  cache_key after;
+  if(job->code != COLORFLOW_OK || !identified || getCacheKey(&after, job->filename, 0, (uint32_t)options->fast_jpeg) != 0){
+    return;
+  }
+  key.frame_percentage = 0;
+  if(memcmp(&key, &after, sizeof(cache_key)) != 0){
+    return;
+  }
+  for(int i = 0; i < percentages->amount; i++){
+    key.frame_percentage = percentages->values[i];
+    storeCache(cache, &key, job->results[i].width, job->results[i].height, job->results[i].average_RGBA);
+  }
+}
 
-  // These color_type don't have an alpha channel then fill it with 0xff.
-  if(color_type == PNG_COLOR_TYPE_RGB ||
-     color_type == PNG_COLOR_TYPE_GRAY ||
-     color_type == PNG_COLOR_TYPE_PALETTE)
-    png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+/// @brief time of a monotonic clock
+/// @return time in nanoseconds
+int64_t getNanoseconds(void){
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (int64_t)time.tv_sec*1000000000 + time.tv_nsec;
+}
 
-  if(color_type == PNG_COLOR_TYPE_GRAY ||
-     color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
-    png_set_gray_to_rgb(png);
+/// @brief read a whole picture from a file descriptor, a regular file is mapped instead of being copied
+/// @param fd file descriptor, such as the standard input
+/// @param size pointer to store the size of the picture into
+/// @param mapped pointer to store 1 into when the picture is mapped and has to be released with munmap instead of free
+/// @return picture, or NULL with errno set if it could not be read
+unsigned char *readPicture(int fd, size_t *size, int *mapped){
+  struct stat info;
+  *mapped = 0;
+  if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 && lseek(fd, 0, SEEK_CUR) == 0){
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data != MAP_FAILED){
+      *size = info.st_size;
+      *mapped = 1;
+      return (unsigned char*)data;
+    }
+  }
 
-  png_read_update_info(png, info);
+  // Pipes are read into a buffer that doubles when it is full
+  size_t capacity = 65536;
+  unsigned char *data = (unsigned char*)malloc(capacity);
+  *size = 0;
+  while(data){
+    ssize_t length = read(fd, data + *size, capacity - *size);
+    if(length < 0 && errno == EINTR){
+      continue;
+    }
+    if(length < 0){
+      free(data);
+      return NULL;
+    }
+    if(length == 0){
+      return data;
+    }
+    *size += length;
+    if(*size == capacity){
+      capacity *= 2;
+      unsigned char *bigger = (unsigned char*)realloc(data, capacity);
+      if(!bigger){
+        free(data);
+      }
+      data = bigger;
+    }
+  }
+  errno = ENOMEM;
+  return NULL;
+}
 
-  if (row_pointers) abort();
+/// @brief compute the average colors of the frames of the picture read from the standard input, or of the zones of its frame
+/// @param ctx context of the computation
+/// @param job file named -, its results are stored in it
+/// @param options options of the computation
+/// @param percentages frame percentages, the picture is decoded once for all of them
+/// @param zones zones of the frame
+void computeStandardInput(colorflow_ctx *ctx, file_job *job, colorflow_options *options, percentage_list *percentages, zone_layout *zones){
+  size_t size;
+  int mapped;
+  int64_t start = getNanoseconds();
+  unsigned char *data = readPicture(STDIN_FILENO, &size, &mapped);
+  if(!data){
+    job->code = errno == ENOMEM ? EXIT_FAILURE_MALLOC : EXIT_FAILURE_OPEN_FAILED;
+    job->error_number = errno;
+    return;
+  }
+  // Reading the standard input is the opening of the picture, libcolorflow counts its size
+  if(ctx->profile){
+    ctx->profile->nanoseconds[COLORFLOW_STAGE_OPEN] += getNanoseconds() - start;
+    ctx->profile->start = start;
+  }
 
-  row_pointers = (png_bytep*)malloc(sizeof(png_bytep) * height);
-  for(int y = 0; y < height; y++) {
-    row_pointers[y] = (png_byte*)malloc(png_get_rowbytes(png,info));
+  if(zones->top_amount){
+    job->code = colorflow_compute_zones_memory(ctx, data, size, options, zones->top_amount, zones->side_amount, job->zone_RGBA, job->results);
+  }
+  else{
+    job->code = colorflow_compute_percentages_memory(ctx, data, size, options, percentages->values, percentages->amount, job->results);
   }
+  job->error_number = errno;
 
-  png_read_image(png, row_pointers);
+  if(mapped){
+    munmap(data, size);
+  }
+  else{
+    free(data);
+  }
+}
 
-  // Allowing the memory for the matrix of pixels
-  pixel** pixels = (pixel**)malloc(height*sizeof(pixel*) + height*width*sizeof(pixel));
-  if(!pixels){
-        fprintf(stderr,"Error while allowing memory for pixel matrix.\n");
-        exit(EXIT_FAILURE_MALLOC);
+/// @brief compute the average colors of the frames of a file, or of the zones of its frame
+/// @param ctx context reused from one file to the next
+/// @param job file to compute, its results are stored in it
+/// @param options options of the computation
+/// @param percentages frame percentages, the file is decoded once for all of them
+/// @param zones zones of the frame
+/// @param cache result cache of the frame colors, NULL without --cache
+void computeFile(colorflow_ctx *ctx, file_job *job, colorflow_options *options, percentage_list *percentages, zone_layout *zones, result_cache *cache){
+  job->sampled = options->sample_stride > 1 || options->sample_budget > 0;
+  // The picture named - is read from the standard input, it has no identity to be cached with
+  if(strcmp(job->filename, "-") == 0){
+    computeStandardInput(ctx, job, options, percentages, zones);
+    return;
+  }
+  if(zones->top_amount){
+    job->code = colorflow_compute_zones(ctx, job->filename, options, zones->top_amount, zones->side_amount, job->zone_RGBA, job->results);
+  }
+  else if(cache){
+    computeCachedFile(ctx, job, options, percentages, cache);
+    return;
   }
+  else{
+    job->code = colorflow_compute_percentages(ctx, job->filename, options, percentages->values, percentages->amount, job->results);
+  }
+  job->error_number = errno;
+}
 
-  for(int y = 0; y < height; y++) {
-    pixels[y] = (pixel*)(pixels + height) + width * y;
-    png_bytep row = row_pointers[y];
-    for(int x = 0; x < width; x++) {
-      png_bytep px = &(row[x * 4]);
-      pixels[y][x] = createPixel(px[0],px[1],px[2],px[3]);
+/// @brief display the result of a file, or its error
+/// @param job computed file
+/// @param percentages frame percentages, each color is followed by its percentage when there are several
+/// @param zones zones of the frame, their colors replace the one of the frame
+/// @param batch_mode display the name of the file after its color
+/// @return number of characters displayed on the standard output
+int displayResult(file_job *job, percentage_list *percentages, zone_layout *zones, int batch_mode){
+  if(job->code != COLORFLOW_OK){
+    if(batch_mode && job->code != EXIT_FAILURE_OPEN_FAILED){
+      fprintf(stderr,"%s: ", job->filename);
     }
+    errno = job->error_number;
+    displayError(job->filename, job->code);
+    return 0;
   }
 
-  // Free ressources
-  png_destroy_read_struct(&png, &info, NULL);
+  int length = 0;
+  if(zones->top_amount){
+    for(int i = 0; i < zoneAmount(zones); i++){
+      int* zone_RGBA = job->zone_RGBA + 4*i;
+      length += printf(i ? " %02X%02X%02X-%02X" : "%02X%02X%02X-%02X",zone_RGBA[0],zone_RGBA[1],zone_RGBA[2],zone_RGBA[3]);
+    }
+    if(batch_mode){
+      length += printf(" %s",job->filename);
+    }
+    length += printf("\n");
+    return length;
+  }
 
-  return pixels;
+  for(int i = 0; i < percentages->amount; i++){
+    int* average_RGBA = job->results[i].average_RGBA;
+    length += printf("%02X%02X%02X-%02X",average_RGBA[0],average_RGBA[1],average_RGBA[2],average_RGBA[3]);
+    if(job->sampled){
+      float *error = job->results[i].standard_error;
+      length += printf(" se %.2f,%.2f,%.2f,%.2f",error[0],error[1],error[2],error[3]);
+    }
+    if(percentages->amount > 1){
+      length += printf(" %d",percentages->numbers[i]);
+    }
+    if(batch_mode){
+      length += printf(" %s",job->filename);
+    }
+    length += printf("\n");
+  }
+  return length;
 }
 
-/// @brief read a jpeg file and store the RGBA values of each pixel in a matrix
-/// @param file binary file of a jpeg picture
-/// @return matrix of pixels that contains the RGBA values of each pixel
-/// @author code inspired by this code https://github.com/LuaDist/libjpeg/blob/master/example.c
-pixel** read_jpg_file(FILE *file){
-
-  if(debug_mode){
-    displayDebugInfo("pixel** read_jpg_file(FILE *file)");
+/// @brief display a string as a JSON string, between quotes
+/// @param stream stream to write to
+/// @param string string to escape
+void displayJSONString(FILE *stream, const char *string){
+  fputc('"', stream);
+  for(const unsigned char *c = (const unsigned char*)string; *c; c++){
+    if(*c == '"' || *c == '\\'){
+      fprintf(stream, "\\%c", *c);
+    }
+    else if(*c < 0x20){
+      fprintf(stream, "\\u%04x", *c);
+    }
+    else{
+      fputc(*c, stream);
+    }
   }
+  fputc('"', stream);
+}
 
-  // Structure for JPEG picture
-  struct jpeg_decompress_struct cinfo;
-  struct jpeg_error_mgr jerr;
-
-  cinfo.err = jpeg_std_error(&jerr);
-  jpeg_create_decompress(&cinfo);
-
-  // Link with JPEG file
-  jpeg_stdio_src(&cinfo, file);
-
-  // Reading headers
-  (void) jpeg_read_header(&cinfo, TRUE);
+/// @brief display the stages of a profile as the members of a JSON object
+/// @param profile stages to display
+/// @return total time of the stages in nanoseconds
+int64_t displayJSONStages(colorflow_profile *profile){
+  int64_t total = 0;
+  fprintf(stderr, "\"stages\":{");
+  for(int i = 0; i < COLORFLOW_STAGE_AMOUNT; i++){
+    fprintf(stderr, "%s\"%s\":{\"ns\":%lld,\"bytes\":%lld}", i ? "," : "", stage_names[i], (long long)profile->nanoseconds[i], (long long)profile->bytes[i]);
+    total += profile->nanoseconds[i];
+  }
+  fprintf(stderr, "},\"total_ns\":%lld", (long long)total);
+  return total;
+}
 
-  // Start decompress
-  (void) jpeg_start_decompress(&cinfo);
+/// @brief display the stages of a computed file on the error output and add them to the report
+/// @param job computed file whose result has been displayed
+/// @param report stage times of the run
+void displayProfile(file_job *job, profile_report *report){
+  colorflow_profile *profile = &job->profile;
+  for(int i = 0; i < COLORFLOW_STAGE_AMOUNT; i++){
+    report->total.nanoseconds[i] += profile->nanoseconds[i];
+    report->total.bytes[i] += profile->bytes[i];
+  }
+  report->file_amount++;
+
+  if(report->format == PROFILE_JSON){
+    fprintf(stderr, "{\"file\":");
+    displayJSONString(stderr, job->filename);
+    fprintf(stderr, ",\"code\":%d,", job->code);
+    displayJSONStages(profile);
+    fprintf(stderr, "}\n");
+    return;
+  }
 
-  // Reading pictures informations
-  width = cinfo.output_width;
-  height = cinfo.output_height;
-  int numComponents = cinfo.output_components;
-  int row_stride = width * numComponents;
+  int64_t total = 0;
+  fprintf(stderr, "%s:", job->filename);
+  for(int i = 0; i < COLORFLOW_STAGE_AMOUNT; i++){
+    fprintf(stderr, " %s %.3f ms,", stage_names[i], profile->nanoseconds[i]/1e6);
+    total += profile->nanoseconds[i];
+  }
+  fprintf(stderr, " total %.3f ms\n", total/1e6);
+}
 
-  // Allow memory to be able to read 1 line of the picture
-  JSAMPARRAY buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
+/// @brief display the stages of every file of the run on the error output, with the throughput of each stage
+/// @param report stage times of the run
+void displayProfileSummary(profile_report *report){
+  int64_t wall = getNanoseconds() - report->start;
+  colorflow_profile *profile = &report->total;
+
+  if(report->format == PROFILE_JSON){
+    fprintf(stderr, "{\"summary\":{\"files\":%d,\"wall_ns\":%lld,", report->file_amount, (long long)wall);
+    displayJSONStages(profile);
+    fprintf(stderr, "}}\n");
+    return;
+  }
 
-  // Allowing the memory for the matrix of pixels
-  pixel** pixels = (pixel**)malloc(height*sizeof(pixel*) + height*width*sizeof(pixel));
-  if(!pixels){
-        fprintf(stderr,"Error while allowing memory.\n");
-        exit(EXIT_FAILURE_MALLOC);
+  // With several threads the stages of the files overlap, their total can exceed the time of the run
+  int64_t total = 0;
+  for(int i = 0; i < COLORFLOW_STAGE_AMOUNT; i++){
+    total += profile->nanoseconds[i];
   }
+  fprintf(stderr, "%d files profiled in %.3f ms\n", report->file_amount, wall/1e6);
+  fprintf(stderr, "%-10s %12s %7s %14s %10s\n", "stage", "time ms", "share", "bytes", "MB/s");
+  for(int i = 0; i < COLORFLOW_STAGE_AMOUNT; i++){
+    int64_t time = profile->nanoseconds[i];
+    fprintf(stderr, "%-10s %12.3f %6.1f%% %14lld %10.1f\n", stage_names[i], time/1e6, total ? 100.0*time/total : 0.0, (long long)profile->bytes[i], time ? 1e3*profile->bytes[i]/time : 0.0);
+  }
+  fprintf(stderr, "%-10s %12.3f\n", "total", total/1e6);
+}
 
+/// @brief add a span of a file to the trace of a worker
+/// @param report stage times of the run
+/// @param thread index of the worker
+/// @param job file of the span
+/// @param name name of the span
+/// @param start time the span started at, in nanoseconds
+/// @param end time the span ended at, in nanoseconds
+/// @param value_name name of an extra number of the span, NULL for none
+/// @param value extra number of the span
+void traceSpan(profile_report *report, int thread, file_job *job, const char *name, int64_t start, int64_t end, const char *value_name, int64_t value){
+  trace_span span;
+  span.name = name;
+  span.start = start;
+  span.end = end;
+  span.file = job->filename;
+  // The results are zero until the file is computed, so the hash of a file has no dimensions
+  span.width = job->code == COLORFLOW_OK ? job->results[0].width : 0;
+  span.height = job->code == COLORFLOW_OK ? job->results[0].height : 0;
+  span.value_name = value_name;
+  span.value = value;
+  addTraceSpan(report->trace, thread, &span);
+}
 
-  for(int y=0; y<height;y++){
-    (void) jpeg_read_scanlines(&cinfo, buffer, 1);
-    pixels[y] = (pixel*)(pixels + height) + width * y;
-    for (int x = 0; x < width; x++) {
-      pixels[y][x] = createPixel(
-        buffer[0][x * numComponents],
-        buffer[0][x * numComponents + 1],
-        buffer[0][x * numComponents + 2],
-        (cinfo.output_components == 4) ? buffer[0][x * numComponents + 3] : 255);
+/// @brief add the computation of a file to the trace of a worker, split into reading, decoding, accumulating and closing
+/// @param report stage times of the run, nothing is traced without --trace
+/// @param thread index of the worker that computed the file
+/// @param job computed file
+void traceJob(profile_report *report, int thread, file_job *job){
+  colorflow_profile *profile = &job->profile;
+  // Files whose colors all come from the cache are not decoded
+  if(!report || !report->trace || profile->start == 0){
+    return;
+  }
+  int64_t end = profile->start;
+  for(int i = 0; i < COLORFLOW_STAGE_AMOUNT; i++){
+    if(profile->end[i] > end){
+      end = profile->end[i];
     }
   }
+  traceSpan(report, thread, job, "compute", profile->start, end, NULL, 0);
+
+  // The stages end one after the other, except the rows summed while they are decoded
+  int64_t read_end = profile->end[COLORFLOW_STAGE_SNIFF] ? profile->end[COLORFLOW_STAGE_SNIFF] : end;
+  traceSpan(report, thread, job, "read", profile->start, read_end, NULL, 0);
+  int64_t decode_end = read_end;
+  for(int i = COLORFLOW_STAGE_HEADER; i <= COLORFLOW_STAGE_REPACK; i++){
+    if(profile->end[i] > decode_end){
+      decode_end = profile->end[i];
+    }
+  }
+  int64_t accumulate_end = profile->end[COLORFLOW_STAGE_ACCUMULATE] > decode_end ? profile->end[COLORFLOW_STAGE_ACCUMULATE] : decode_end;
+  int64_t interleaved = profile->nanoseconds[COLORFLOW_STAGE_ACCUMULATE] - (accumulate_end - decode_end);
+  if(decode_end > read_end){
+    traceSpan(report, thread, job, "decode", read_end, decode_end, "interleaved_accumulate_ns", interleaved > 0 ? interleaved : 0);
+  }
+  if(accumulate_end > decode_end){
+    traceSpan(report, thread, job, "accumulate", decode_end, accumulate_end, NULL, 0);
+  }
+  if(end > accumulate_end){
+    traceSpan(report, thread, job, "close", accumulate_end, end, NULL, 0);
+  }
+}
 
-  // Finish decompress
-  (void) jpeg_finish_decompress(&cinfo);
-
-  // Free ressources
-  jpeg_destroy_decompress(&cinfo);
-
-  return pixels;
+/// @brief display the result of a file, with --profile the time of the display is added to its stages, which are displayed after it
+/// @param job computed file
+/// @param percentages frame percentages
+/// @param zones zones of the frame
+/// @param batch_mode display the name of the file after its color
+/// @param report stage times of the run, NULL without --profile and --trace
+/// @param thread index of the worker displaying the result, the display is added to its trace
+void displayJob(file_job *job, percentage_list *percentages, zone_layout *zones, int batch_mode, profile_report *report, int thread){
+  if(!report){
+    displayResult(job, percentages, zones, batch_mode);
+    return;
+  }
+  int64_t start = getNanoseconds();
+  int length = displayResult(job, percentages, zones, batch_mode);
+  int64_t end = getNanoseconds();
+  job->profile.nanoseconds[COLORFLOW_STAGE_OUTPUT] += end - start;
+  job->profile.bytes[COLORFLOW_STAGE_OUTPUT] += length;
+  if(report->trace){
+    traceSpan(report, thread, job, "output", start, end, NULL, 0);
+  }
+  if(report->format){
+    displayProfile(job, report);
+  }
 }
 
-/******************************************************************************************************************************************************************************
- *                                                                                                                                                                            *
- *                 Reading BMP files, all the following part is inspired by example code of libnsbmp http://source.netsurf-browser.org/libnsbmp.git/                          *
- *                                                                                                                                                                            *
-*******************************************************************************************************************************************************************************/
+/// @brief compute and display the average color of the frame of a file
+/// @param ctx context reused from one file to the next
+/// @param filename name of the file
+/// @param options options of the computation
+/// @param percentages frame percentages
+/// @param zones zones of the frame
+/// @param cache result cache, NULL without --cache
+/// @param batch_mode display the name of the file after its color
+/// @param report stage times of the run, NULL without --profile and --trace
+/// @return 0 or the error code returned by libcolorflow
+int processFile(colorflow_ctx *ctx, char* filename, colorflow_options *options, percentage_list *percentages, zone_layout *zones, result_cache *cache, int batch_mode, profile_report *report){
+  file_job job;
+  memset(&job.profile, 0, sizeof(job.profile));
+  job.filename = filename;
+  job.results = (colorflow_result*)malloc(percentages->amount*sizeof(colorflow_result));
+  // One more value keeps the allocation from being empty without zones
+  job.zone_RGBA = (int*)malloc((4*zoneAmount(zones) + 1)*sizeof(int));
+  if(!job.results || !job.zone_RGBA){
+    displayError(NULL, EXIT_FAILURE_MALLOC);
+    exit(EXIT_FAILURE_MALLOC);
+  }
+  ctx->profile = report ? &job.profile : NULL;
+  computeFile(ctx, &job, options, percentages, zones, cache);
+  ctx->profile = NULL;
+  traceJob(report, 0, &job);
+  displayJob(&job, percentages, zones, batch_mode, report, 0);
+  free(job.results);
+  free(job.zone_RGBA);
+  return job.code;
+}
 
-#define BYTES_PER_PIXEL 4
-#define MAX_IMAGE_BYTES (48 * 1024 * 1024)
+/// @brief read the next name of a list separated by newlines or NUL characters
+/// @param list file that contains the list
+/// @param buffer buffer of the name, grown when needed
+/// @param capacity number of bytes allowed for buffer
+/// @return the name stored in buffer, or NULL at the end of the list
+char* readName(FILE *list, char **buffer, size_t *capacity){
+  size_t length = 0;
+  int c;
+  do{
+    c = getc_unlocked(list);
+    if(c == '\n' || c == '\0' || c == EOF){
+      // Names written on Windows end with \r
+      if(length > 0 && (*buffer)[length-1] == '\r'){
+        length--;
+      }
+      if(length > 0){
+        (*buffer)[length] = '\0';
+        return *buffer;
+      }
+    }
+    else{
+      if(length + 1 >= *capacity){
+        *capacity *= 2;
+        char *bigger = (char*)realloc(*buffer, *capacity);
+        if(!bigger){
+          displayError(NULL, EXIT_FAILURE_MALLOC);
+          exit(EXIT_FAILURE_MALLOC);
+        }
+        *buffer = bigger;
+      }
+      (*buffer)[length++] = c;
+    }
+  } while(c != EOF);
+  return NULL;
+}
 
-static void *bitmap_create(int width, int height, unsigned int state)
-{
-  (void) state;  /* unused */
-  /* ensure a stupidly large (>50Megs or so) bitmap is not created */
-  if (((long long)width * (long long)height) > (MAX_IMAGE_BYTES/BYTES_PER_PIXEL)) {
-          return NULL;
+/// @brief process every file of a list, one at a time as they are read
+/// @param ctx context reused from one file to the next
+/// @param list file that contains the list
+/// @param options options of the computation
+/// @param percentages frame percentages
+/// @param zones zones of the frame
+/// @param cache result cache, NULL without --cache
+/// @param report stage times of the run, NULL without --profile and --trace
+/// @return 0 or the first error code returned by libcolorflow
+int processList(colorflow_ctx *ctx, FILE *list, colorflow_options *options, percentage_list *percentages, zone_layout *zones, result_cache *cache, profile_report *report){
+  int exit_code = 0;
+  size_t capacity = 256;
+  char *filename = (char*)malloc(capacity);
+  if(!filename){
+    displayError(NULL, EXIT_FAILURE_MALLOC);
+    exit(EXIT_FAILURE_MALLOC);
   }
-  return calloc(width * height, BYTES_PER_PIXEL);
-}
 
+  while(readName(list, &filename, &capacity)){
+    int code = processFile(ctx, filename, options, percentages, zones, cache, 1, report);
+    if(code && !exit_code){
+      exit_code = code;
+    }
+  }
 
-static unsigned char *bitmap_get_buffer(void *bitmap)
-{
-  assert(bitmap);
-  return (unsigned char*)bitmap;
+  free(filename);
+  return exit_code;
 }
 
+/// @brief append every name of a list to an array of names
+/// @param list file that contains the list
+/// @param filenames array of names, grown when needed
+/// @param file_amount number of names in filenames
+/// @param file_capacity number of names allowed for filenames
+void appendList(FILE *list, char ***filenames, int *file_amount, int *file_capacity){
+  size_t capacity = 256;
+  char *filename = (char*)malloc(capacity);
+  if(!filename){
+    displayError(NULL, EXIT_FAILURE_MALLOC);
+    exit(EXIT_FAILURE_MALLOC);
+  }
 
-static size_t bitmap_get_bpp(void *bitmap)
-{
-  (void) bitmap;  /* unused */
-  return BYTES_PER_PIXEL;
-}
+  while(readName(list, &filename, &capacity)){
+    if(*file_amount == *file_capacity){
+      *file_capacity *= 2;
+      char **bigger = (char**)realloc(*filenames, *file_capacity*sizeof(char*));
+      if(!bigger){
+        displayError(NULL, EXIT_FAILURE_MALLOC);
+        exit(EXIT_FAILURE_MALLOC);
+      }
+      *filenames = bigger;
+    }
+    (*filenames)[*file_amount] = strdup(filename);
+    if(!(*filenames)[*file_amount]){
+      displayError(NULL, EXIT_FAILURE_MALLOC);
+      exit(EXIT_FAILURE_MALLOC);
+    }
+    (*file_amount)++;
+  }
 
+  free(filename);
+}
 
-static void bitmap_destroy(void *bitmap)
-{
-  assert(bitmap);
-  free(bitmap);
+/// @brief work of the scheduler: compute one file then display every result that is ready
+/// @param thread index of the worker
+/// @param index index of the file, or of the leader with --dedup
+/// @param data file_batch shared by the workers
+void processJob(int thread, int index, void *data){
+  file_batch *batch = (file_batch*)data;
+  file_job *job = &batch->jobs[batch->leaders ? batch->leaders[index] : index];
+  colorflow_ctx *ctx = batch->contexts[thread];
+  ctx->profile = batch->report ? &job->profile : NULL;
+  computeFile(ctx, job, batch->options, batch->percentages, batch->zones, batch->cache);
+  ctx->profile = NULL;
+  traceJob(batch->report, thread, job);
+
+  pthread_mutex_lock(&batch->output_lock);
+  job->done = 1;
+
+  // Files with the same content take the results of the computed one
+  for(int next = job->next_duplicate; next != -1; next = batch->jobs[next].next_duplicate){
+    file_job *duplicate = &batch->jobs[next];
+    duplicate->code = job->code;
+    duplicate->error_number = job->error_number;
+    duplicate->sampled = job->sampled;
+    memcpy(duplicate->results, job->results, batch->percentages->amount*sizeof(colorflow_result));
+    memcpy(duplicate->zone_RGBA, job->zone_RGBA, 4*zoneAmount(batch->zones)*sizeof(int));
+    duplicate->done = 1;
+  }
+  if(batch->unordered){
+    // The files with the same content are displayed with the computed one
+    displayJob(job, batch->percentages, batch->zones, batch->batch_mode, batch->report, thread);
+    for(int next = job->next_duplicate; next != -1; next = batch->jobs[next].next_duplicate){
+      displayJob(&batch->jobs[next], batch->percentages, batch->zones, batch->batch_mode, batch->report, thread);
+    }
+  }
+  else{
+    // The results are displayed in input order, the later ones wait for the earlier ones
+    while(batch->next_output < batch->job_amount && batch->jobs[batch->next_output].done){
+      displayJob(&batch->jobs[batch->next_output], batch->percentages, batch->zones, batch->batch_mode, batch->report, thread);
+      batch->next_output++;
+    }
+  }
+  pthread_mutex_unlock(&batch->output_lock);
 }
 
-static unsigned char *load_bmp_file(FILE *fd, size_t *data_size)
-{
-  if(debug_mode){
-    char debugInfo[100];
-    sprintf(debugInfo, "static unsigned char *load_bmp_file(FILE *fd, size_t *data_size = %ld)",*data_size);
-    displayDebugInfo(debugInfo);
+/// @brief work of the scheduler: hash the content of one file
+/// @param thread index of the worker
+/// @param index index of the file
+/// @param data file_batch shared by the workers
+void hashJob(int thread, int index, void *data){
+  file_batch *batch = (file_batch*)data;
+  file_job *job = &batch->jobs[index];
+  int64_t start = batch->report && batch->report->trace ? getNanoseconds() : 0;
+  job->hashed = hashFile(job->filename, &job->content_hash, &job->content_size) == 0;
+  if(start){
+    traceSpan(batch->report, thread, job, "hash", start, getNanoseconds(), "bytes", (int64_t)job->content_size);
   }
+}
 
-  unsigned char *buffer;
-  size_t n;
+// Content of a file, sorted to bring the files with the same content together
+typedef struct{
+  uint64_t hash;
+  uint64_t size;
+  int job;
+} file_content;
+
+/// @brief order of the contents by hash, size and job
+/// @param a first file_content
+/// @param b second file_content
+/// @return negative, 0 or positive as for qsort
+int compareContents(const void *a, const void *b){
+  const file_content *first = (const file_content*)a;
+  const file_content *second = (const file_content*)b;
+  if(first->hash != second->hash){
+    return first->hash < second->hash ? -1 : 1;
+  }
+  if(first->size != second->size){
+    return first->size < second->size ? -1 : 1;
+  }
+  return first->job - second->job;
+}
 
-  buffer = (unsigned char*)malloc(size);
-  if (!buffer) {
-    fprintf(stderr,"Error while allowing memory.\n");
+/// @brief chain the jobs whose files have the same hash and size to the first of them, its leader
+/// @param batch batch whose files have been hashed
+/// @param leaders array of at least job_amount values, filled with the leaders in input order
+/// @return number of leaders
+int findDuplicates(file_batch *batch, int *leaders){
+  file_content *contents = (file_content*)malloc(batch->job_amount*sizeof(file_content));
+  if(!contents){
+    displayError(NULL, EXIT_FAILURE_MALLOC);
     exit(EXIT_FAILURE_MALLOC);
   }
+  int content_amount = 0;
+  for(int i = 0; i < batch->job_amount; i++){
+    batch->jobs[i].next_duplicate = -1;
+    if(batch->jobs[i].hashed){
+      contents[content_amount].hash = batch->jobs[i].content_hash;
+      contents[content_amount].size = batch->jobs[i].content_size;
+      contents[content_amount].job = i;
+      content_amount++;
+    }
+  }
+  qsort(contents, content_amount, sizeof(file_content), compareContents);
 
-  n = fread(buffer, 1, size, fd);
-  if (n != size) {
-    exit(EXIT_FAILURE);
+  // The jobs of a group are sorted by index, the first one is the leader
+  int *is_duplicate = (int*)calloc(batch->job_amount, sizeof(int));
+  if(!is_duplicate){
+    displayError(NULL, EXIT_FAILURE_MALLOC);
+    exit(EXIT_FAILURE_MALLOC);
+  }
+  for(int i = 1; i < content_amount; i++){
+    if(contents[i].hash == contents[i-1].hash && contents[i].size == contents[i-1].size){
+      batch->jobs[contents[i-1].job].next_duplicate = contents[i].job;
+      is_duplicate[contents[i].job] = 1;
+    }
   }
 
-  *data_size = size;
-  return buffer;
+  // Files that could not be hashed are leaders, their errors are found by libcolorflow
+  int leader_amount = 0;
+  for(int i = 0; i < batch->job_amount; i++){
+    if(!is_duplicate[i]){
+      leaders[leader_amount++] = i;
+    }
+  }
+  free(is_duplicate);
+  free(contents);
+  return leader_amount;
 }
 
-/// @brief read a bmp file and store the RGBA values of each pixel in a matrix
-/// @param file binary file of a bmp picture
-/// @return matrix of pixels that contains the RGBA values of each pixel
-/// @authors code inspired by http://source.netsurf-browser.org/libnsbmp.git/
-pixel** read_bmp_file(FILE *file){
-
-  if(debug_mode){
-    displayDebugInfo("pixel** read_bmp_file(FILE *file)");
+/// @brief process files on a pool of threads
+/// @param filenames names of the files
+/// @param file_amount number of files
+/// @param thread_amount number of threads
+/// @param options options of the computation
+/// @param percentages frame percentages
+/// @param zones zones of the frame
+/// @param cache result cache, NULL without --cache
+/// @param batch_mode display the name of the file after its color
+/// @param unordered display the results as soon as they are computed instead of in input order
+/// @param dedup hash the content of the files and compute the files with the same content once
+/// @param report stage times of the run, NULL without --profile and --trace
+/// @return 0 or the first error code returned by libcolorflow, in input order
+int processFiles(char** filenames, int file_amount, int thread_amount, colorflow_options *options, percentage_list *percentages, zone_layout *zones, result_cache *cache, int batch_mode, int unordered, int dedup, profile_report *report){
+  if(file_amount == 0){
+    return 0;
+  }
+  if(thread_amount > file_amount){
+    thread_amount = file_amount;
+  }
+  file_batch batch;
+  batch.jobs = (file_job*)calloc(file_amount, sizeof(file_job));
+  batch.contexts = (colorflow_ctx**)calloc(thread_amount, sizeof(colorflow_ctx*));
+  colorflow_result *results = (colorflow_result*)calloc((size_t)file_amount*percentages->amount, sizeof(colorflow_result));
+  int *zone_RGBA = (int*)calloc((size_t)file_amount*4*zoneAmount(zones) + 1, sizeof(int));
+  if(!batch.jobs || !batch.contexts || !results || !zone_RGBA){
+    displayError(NULL, EXIT_FAILURE_MALLOC);
+    exit(EXIT_FAILURE_MALLOC);
+  }
+  batch.job_amount = file_amount;
+  batch.options = options;
+  batch.percentages = percentages;
+  batch.zones = zones;
+  batch.cache = cache;
+  batch.leaders = NULL;
+  batch.batch_mode = batch_mode;
+  batch.unordered = unordered;
+  batch.next_output = 0;
+  batch.report = report;
+  pthread_mutex_init(&batch.output_lock, NULL);
+
+  for(int i = 0; i < file_amount; i++){
+    batch.jobs[i].filename = filenames[i];
+    batch.jobs[i].results = results + (size_t)i*percentages->amount;
+    batch.jobs[i].zone_RGBA = zone_RGBA + (size_t)i*4*zoneAmount(zones);
+  }
+  // Every thread keeps its own context, with its buffers and decoders, for all its files
+  for(int i = 0; i < thread_amount; i++){
+    batch.contexts[i] = colorflow_ctx_create();
+    if(!batch.contexts[i]){
+      displayError(NULL, EXIT_FAILURE_MALLOC);
+      exit(EXIT_FAILURE_MALLOC);
+    }
   }
 
-  bmp_bitmap_callback_vt bitmap_callbacks = {
-    bitmap_create,
-    bitmap_destroy,
-    bitmap_get_buffer,
-    bitmap_get_bpp
-  };
-  bmp_result code;
-  bmp_image bmp;
-  size_t data_size;
-
-  /* create our bmp image */
-  bmp_create(&bmp, &bitmap_callbacks);
-
-  /* load file into memory */
-  unsigned char *data = load_bmp_file(file, &data_size);
-
-  /* analyse the BMP */
-  code = bmp_analyse(&bmp, size, data);
-  if (code != BMP_OK) {
-    goto cleanup;
+  // With --dedup, every file is hashed first, then only the leaders are computed
+  int job_amount = file_amount;
+  if(dedup){
+    batch.leaders = (int*)malloc(file_amount*sizeof(int));
+    if(!batch.leaders || runJobs(file_amount, thread_amount, hashJob, &batch)){
+      displayError(NULL, EXIT_FAILURE_MALLOC);
+      exit(EXIT_FAILURE_MALLOC);
+    }
+    job_amount = findDuplicates(&batch, batch.leaders);
+  }
+  else{
+    for(int i = 0; i < file_amount; i++){
+      batch.jobs[i].next_duplicate = -1;
+    }
   }
 
-  /* decode the image */
-  code = bmp_decode(&bmp);
-  if (code != BMP_OK) {
-    goto cleanup;
-  }  
+  if(runJobs(job_amount, thread_amount, processJob, &batch)){
+    displayError(NULL, EXIT_FAILURE_MALLOC);
+    exit(EXIT_FAILURE_MALLOC);
+  }
+  if(dedup){
+    fprintf(stderr,"%d files, %d decodes saved by identical files\n", file_amount, file_amount - job_amount);
+  }
 
-  height = bmp.height;
-  width = bmp.width;
+  int exit_code = 0;
+  for(int i = 0; i < file_amount && !exit_code; i++){
+    exit_code = batch.jobs[i].code;
+  }
 
-  // Allowing the memory for the matrix of pixels
-  pixel** pixels = (pixel**)malloc(height*sizeof(pixel*) + height*width*sizeof(pixel));
-  if(!pixels){
-        fprintf(stderr,"Error while allowing memory.\n");
-        exit(EXIT_FAILURE_MALLOC);
+  // Free ressources
+  for(int i = 0; i < thread_amount; i++){
+    colorflow_ctx_destroy(batch.contexts[i]);
   }
+  pthread_mutex_destroy(&batch.output_lock);
+  free(batch.contexts);
+  free(batch.leaders);
+  free(batch.jobs);
+  free(results);
+  free(zone_RGBA);
+  return exit_code;
+}
 
-  uint8_t *image = (uint8_t *) bmp.bitmap;
-  for (int y = 0; y < height; y++) {
-    pixels[y] = (pixel*)(pixels + height) + width * y;
-    for (int x = 0; x < width; x++) {
-      size_t z = (y * width + x) * BYTES_PER_PIXEL;
-      pixels[y][x] = createPixel(image[z],image[z + 1],image[z + 2],255);
+/// @brief work of the server: compute the answer of a request "path percentages", the percentages being optional
+/// @param worker index of the worker
+/// @param request request of a client, its percentages are removed from it
+/// @param data file_batch shared by the workers
+/// @return the colors of the frames separated by spaces, the colors of the zones, or "ERROR code errno", allocated with malloc
+char* serveRequest(int worker, char *request, void *data){
+  file_batch *batch = (file_batch*)data;
+
+  // The last word is the list of frame percentages when it is made of numbers and commas, the path may contain spaces
+  int numbers[100];
+  float values[100];
+  percentage_list percentages = {0, numbers, values};
+  int code = COLORFLOW_OK;
+  char *space = strrchr(request, ' ');
+  if(space && space[1] && strspn(space + 1, "0123456789,") == strlen(space + 1)){
+    *space = '\0';
+    for(char *number = space + 1; number && code == COLORFLOW_OK; number = strchr(number, ',')){
+      number += *number == ',';
+      if(percentages.amount == 100){
+        code = EXIT_FAILURE_BAD_PERCENTAGE;
+        break;
+      }
+      numbers[percentages.amount++] = atoi(number);
     }
   }
+  else{
+    percentages.amount = batch->percentages->amount;
+    memcpy(numbers, batch->percentages->numbers, percentages.amount*sizeof(int));
+  }
+  for(int i = 0; i < percentages.amount; i++){
+    values[i] = (float)(numbers[i]/100.0);
+    if(numbers[i] <= 0 || numbers[i] > 100){
+      code = EXIT_FAILURE_BAD_PERCENTAGE;
+    }
+  }
+  if(batch->zones->top_amount && percentages.amount > 1){
+    code = EXIT_FAILURE_BAD_ZONES;
+  }
+  colorflow_options options = *batch->options;
+  options.frame_percentage = values[0];
+
+  colorflow_result results[100];
+  file_job job;
+  memset(&job, 0, sizeof(job));
+  job.filename = request;
+  job.code = code;
+  job.results = results;
+  job.zone_RGBA = (int*)malloc((4*zoneAmount(batch->zones) + 1)*sizeof(int));
+  char *answer = (char*)malloc(11*(zoneAmount(batch->zones) + percentages.amount) + 32);
+  if(!job.zone_RGBA || !answer){
+    free(job.zone_RGBA);
+    free(answer);
+    return NULL;
+  }
+  if(job.code == COLORFLOW_OK){
+    computeFile(batch->contexts[worker], &job, &options, &percentages, batch->zones, batch->cache);
+  }
 
-  cleanup:
-    /* clean up */
-    bmp_finalise(&bmp);
-    free(data);
-
-  return pixels;
+  // The client displays the error itself, with the errno of the worker
+  if(job.code != COLORFLOW_OK){
+    sprintf(answer, "ERROR %d %d", job.code, job.error_number);
+  }
+  else{
+    int *colors = batch->zones->top_amount ? job.zone_RGBA : NULL;
+    int color_amount = batch->zones->top_amount ? zoneAmount(batch->zones) : percentages.amount;
+    char *end = answer;
+    for(int i = 0; i < color_amount; i++){
+      int* RGBA = colors ? colors + 4*i : results[i].average_RGBA;
+      end += sprintf(end, i ? " %02X%02X%02X-%02X" : "%02X%02X%02X-%02X", RGBA[0], RGBA[1], RGBA[2], RGBA[3]);
+    }
+  }
+  free(job.zone_RGBA);
+  return answer;
 }
 
-/// @brief Return the average color of of a certain rectangular area of an image determined by start_row, end_row, start_column, end_column
-/// @param pixels_image matrix of pixels
-/// @param border_average_color array we want to store the average RGBA color into
-/// @param start_row specifies on which row the area starts
-/// @param end_row specifies on which row the area ends
-/// @param start_column specifies on which column the area starts
-/// @param end_column specifies on which column the area ends
-void getAverageBorderColor(pixel** pixels_image, int *border_average_color, int start_row, int end_row, int start_column, int end_column){
-
-  if(debug_mode){
-    char debugInfo[175];
-    sprintf(debugInfo,"void getAverageBorderColor(pixel** pixels_image, int *border_average_color, int start_row = %d, int end_row = %d, int start_column = %d, int end_column = %d)",start_row, end_row,start_column,end_column);
-    displayDebugInfo(debugInfo);
+/// @brief compute the colors of files on a pool of threads for the clients of a UNIX domain socket, until SIGINT or SIGTERM
+/// @param path path of the socket
+/// @param thread_amount number of threads
+/// @param options options of the computation
+/// @param percentages frame percentages, the first one is used by the requests without percentage
+/// @param zones zones of the frame
+/// @param cache result cache, NULL without --cache
+/// @return 0, or EXIT_FAILURE_OPEN_FAILED if the socket could not be served
+int processServer(char *path, int thread_amount, colorflow_options *options, percentage_list *percentages, zone_layout *zones, result_cache *cache){
+  file_batch batch;
+  memset(&batch, 0, sizeof(batch));
+  batch.options = options;
+  batch.percentages = percentages;
+  batch.zones = zones;
+  batch.cache = cache;
+
+  // Every worker keeps its own context, with its buffers and decoders, for all the requests
+  batch.contexts = (colorflow_ctx**)calloc(thread_amount, sizeof(colorflow_ctx*));
+  if(!batch.contexts){
+    displayError(NULL, EXIT_FAILURE_MALLOC);
+    exit(EXIT_FAILURE_MALLOC);
+  }
+  for(int i = 0; i < thread_amount; i++){
+    batch.contexts[i] = colorflow_ctx_create();
+    if(!batch.contexts[i]){
+      displayError(NULL, EXIT_FAILURE_MALLOC);
+      exit(EXIT_FAILURE_MALLOC);
+    }
   }
 
-  // establishing average color of the selected border
-  int pixel_amount = ((end_row-start_row)*(end_column-start_column));
+  int exit_code = 0;
+  if(runServer(path, thread_amount, serveRequest, &batch) != 0){
+    fprintf(stderr,"Error while serving socket %s\n", path);
+    perror("serve");
+    exit_code = EXIT_FAILURE_OPEN_FAILED;
+  }
 
-  // Measure to avoid division by 0
-  if(pixel_amount == 0){
-    pixel_amount = 1; 
+  // Free ressources
+  for(int i = 0; i < thread_amount; i++){
+    colorflow_ctx_destroy(batch.contexts[i]);
   }
+  free(batch.contexts);
+  return exit_code;
+}
 
-  // Summing the values of each pixel
-  for(int y=start_row; y<end_row; y++){
-    for(int x=start_column; x<end_column; x++){
-      border_average_color[0] += (int)pixels_image[y][x].red;
-      border_average_color[1] += (int)pixels_image[y][x].green;
-      border_average_color[2] += (int)pixels_image[y][x].blue;
-      border_average_color[3] += (int)pixels_image[y][x].alpha;
+// Files a client sends before waiting for their answers, fewer than the server reads ahead
+#define CLIENT_REQUESTS 32
+
+// File sent by a client, waiting for its answer
+typedef struct{
+  char *filename;         // name as given
+  int unsent;             // the name cannot be sent, it contains a newline or is the standard input
+} client_request;
+
+/// @brief display the answer of the server for a file, as processFile does
+/// @param request answered file
+/// @param answer answer of the server, one color per frame percentage or the colors of the zones
+/// @param percentages frame percentages
+/// @param batch_mode display the name of the file after its color
+/// @return 0 or the error code returned by libcolorflow on the server
+int displayAnswer(client_request *request, char *answer, percentage_list *percentages, int batch_mode){
+  int code = COLORFLOW_OK;
+  int error_number = 0;
+  if(request->unsent){
+    code = EXIT_FAILURE_OPEN_FAILED;
+    error_number = EINVAL;
+  }
+  else if(sscanf(answer, "ERROR %d %d", &code, &error_number) < 1){
+    code = COLORFLOW_OK;
+  }
+  if(code != COLORFLOW_OK){
+    if(batch_mode && code != EXIT_FAILURE_OPEN_FAILED){
+      fprintf(stderr,"%s: ", request->filename);
     }
+    errno = error_number;
+    displayError(request->filename, code);
+    return code;
   }
 
-  // Dividing each component by the number of pixels
-  for(int i=0;i<4;i++){
-    border_average_color[i] /= pixel_amount;
+  // The colors of the zones of a frame are displayed on one line
+  if(percentages->amount == 1){
+    printf("%s", answer);
+    if(batch_mode){
+      printf(" %s",request->filename);
+    }
+    printf("\n");
+    return code;
+  }
+  char *color = strtok(answer, " ");
+  for(int i = 0; i < percentages->amount && color; i++){
+    printf("%s %d", color, percentages->numbers[i]);
+    if(batch_mode){
+      printf(" %s",request->filename);
+    }
+    printf("\n");
+    color = strtok(NULL, " ");
   }
+  return code;
 }
 
-/// @brief determine the RGBA average color of the specified border
-/// @param pixels_image matrix of pixels
-/// @param frame_percentage percentage of the border to calculate the average RGBA
-/// @return array that contains the average RGBA values
-int* getAverageColor(pixel** pixels_image, float frame_percentage){
+/// @brief have the server of a UNIX domain socket compute the files, and display their colors as processFile does
+/// @param path path of the socket
+/// @param filenames names of the files
+/// @param file_amount number of files
+/// @param list file that contains a list of names, read after filenames, NULL for none
+/// @param percentages frame percentages
+/// @param batch_mode display the name of the file after its color
+/// @return 0 or the first error code returned by the server
+int processClient(char *path, char **filenames, int file_amount, FILE *list, percentage_list *percentages, int batch_mode){
+  server_connection connection;
+  if(connectServer(&connection, path) != 0){
+    fprintf(stderr,"Error while connecting to socket %s\n", path);
+    perror("connect");
+    exit(EXIT_FAILURE_OPEN_FAILED);
+  }
 
-  if(debug_mode){
-    char debugInfo[100];
-    sprintf(debugInfo, "int* getAverageColor(pixel** pixels_image, float frame_percentage = %f)",frame_percentage);
-    displayDebugInfo(debugInfo);
+  // Every request ends with the frame percentages, the server does not share the working directory of the client
+  char *directory = getcwd(NULL, 0);
+  char *numbers = (char*)malloc(4*percentages->amount + 1);
+  size_t name_capacity = 256;
+  char *name = (char*)malloc(name_capacity);
+  size_t line_capacity = 256;
+  char *line = (char*)malloc(line_capacity);
+  size_t answer_capacity = 256;
+  char *answer = (char*)malloc(answer_capacity);
+  client_request *requests = (client_request*)malloc(CLIENT_REQUESTS*sizeof(client_request));
+  if(!directory || !numbers || !name || !line || !answer || !requests){
+    displayError(NULL, EXIT_FAILURE_MALLOC);
+    exit(EXIT_FAILURE_MALLOC);
+  }
+  char *end = numbers;
+  for(int i = 0; i < percentages->amount; i++){
+    end += sprintf(end, i ? ",%d" : "%d", percentages->numbers[i]);
   }
 
-  // Establishing average color of the upper border
-  int up_border_average_color[4] = {0,0,0,0};
-  getAverageBorderColor(pixels_image, up_border_average_color, 0, (int)(height*frame_percentage), 0, width);
+  int exit_code = 0;
+  int next_file = 0;
+  int more = 1;
+  long long sent = 0;
+  long long received = 0;
+  for(;;){
+    while(more && sent - received < CLIENT_REQUESTS){
+      char *filename = NULL;
+      if(next_file < file_amount){
+        filename = filenames[next_file++];
+      }
+      else if(list){
+        filename = readName(list, &name, &name_capacity);
+      }
+      if(!filename){
+        more = 0;
+        break;
+      }
+      client_request *request = &requests[sent++ % CLIENT_REQUESTS];
+      request->filename = strdup(filename);
+      size_t length = strlen(directory) + strlen(filename) + strlen(numbers) + 3;
+      if(length > line_capacity){
+        line_capacity = length;
+        free(line);
+        line = (char*)malloc(line_capacity);
+      }
+      if(!request->filename || !line){
+        displayError(NULL, EXIT_FAILURE_MALLOC);
+        exit(EXIT_FAILURE_MALLOC);
+      }
+      request->unsent = strchr(filename, '\n') != NULL || strcmp(filename, "-") == 0;
+      if(request->unsent){
+        continue;
+      }
+      line[0] = '\0';
+      if(filename[0] != '/'){
+        strcat(strcat(line, directory), "/");
+      }
+      strcat(strcat(strcat(line, filename), " "), numbers);
+      if(sendRequest(&connection, line) != 0){
+        fprintf(stderr,"Error : the server of socket %s closed the connection\n", path);
+        exit(EXIT_FAILURE_OPEN_FAILED);
+      }
+    }
+    if(received == sent){
+      break;
+    }
 
-  // Establishing average color of the right border
-  int right_border_average_color[4] = {0,0,0,0};
-  getAverageBorderColor(pixels_image, right_border_average_color, 0, height, (int)(width*(1-frame_percentage)), width);
+    client_request *request = &requests[received++ % CLIENT_REQUESTS];
+    if(!request->unsent && !readAnswer(&connection, &answer, &answer_capacity)){
+      fprintf(stderr,"Error : the server of socket %s closed the connection\n", path);
+      exit(EXIT_FAILURE_OPEN_FAILED);
+    }
+    int code = displayAnswer(request, answer, percentages, batch_mode);
+    if(code && !exit_code){
+      exit_code = code;
+    }
+    free(request->filename);
+  }
 
-  // Establishing average color of the left border
-  int down_border_average_color[4] = {0,0,0,0};
-  getAverageBorderColor(pixels_image, down_border_average_color, (int)((1-frame_percentage)*height), height, 0, width);
+  // Free ressources
+  disconnectServer(&connection);
+  free(requests);
+  free(answer);
+  free(line);
+  free(name);
+  free(numbers);
+  free(directory);
+  return exit_code;
+}
 
-  // Establishing average color of the lower border
-  int left_border_average_color[4] = {0,0,0,0};
-  getAverageBorderColor(pixels_image, left_border_average_color, 0, height, 0, (int)(width*frame_percentage));
+// Per frame times of a video stream are counted in buckets of one microsecond, the last bucket holds every longer time
+#define LATENCY_BUCKETS 100000
 
-  // Establishing the average color of the frame
-  static int average_RGBA[4];
-  for(int i=0;i<4;i++){
-    average_RGBA[i] = up_border_average_color[i]+right_border_average_color[i]+down_border_average_color[i]+left_border_average_color[i];
-    average_RGBA[i] /= 4;
-  }
-  return average_RGBA;
+/// @brief time of a monotonic clock
+/// @return time in microseconds
+long long getMicroseconds(void){
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (long long)time.tv_sec*1000000 + time.tv_nsec/1000;
 }
 
-/// @brief opens an picture and call the right function depends on its format
-/// @param file binary file of the picture to open-
-/// @param buffer first characters of the binary file that contains the signature of the format
-/// @return matrix of pixels returned by function called 
-pixel** read_data(FILE *file, unsigned char* buffer){
+/// @brief time under which a fraction of the frames have been computed
+/// @param histogram number of frames of each bucket
+/// @param frame_amount number of frames
+/// @param fraction fraction of the frames, in ]0, 1]
+/// @return time in microseconds
+int getPercentile(int *histogram, int frame_amount, double fraction){
+  long long needed = (long long)(fraction*frame_amount + 0.999999);
+  long long count = 0;
+  for(int i = 0; i < LATENCY_BUCKETS; i++){
+    count += histogram[i];
+    if(count >= needed){
+      return i;
+    }
+  }
+  return LATENCY_BUCKETS - 1;
+}
 
-  if(debug_mode){
-    displayDebugInfo("pixel** read_data(FILE *file, unsigned char* buffer)");
+/// @brief compute and display the average color of the frame of every frame of a video stream read from the standard input,
+/// then display the per frame times on the error output
+/// @param ctx context reused from one frame to the next
+/// @param format COLORFLOW_STREAM_RGBA or COLORFLOW_STREAM_Y4M
+/// @param width width of the frames of a raw RGBA stream
+/// @param height height of the frames of a raw RGBA stream
+/// @param options options of the computation
+/// @param zones zones of the frame
+/// @return 0 or the error code returned by libcolorflow
+int processStream(colorflow_ctx *ctx, int format, int width, int height, colorflow_options *options, zone_layout *zones){
+  colorflow_stream stream;
+  int code = colorflow_stream_open(&stream, stdin, format, width, height);
+  if(code != COLORFLOW_OK){
+    displayError("-", code);
+    colorflow_stream_close(&stream);
+    return code;
   }
 
-  pixel** pixels_image;
-  // Compare with png signature
-  if (png_sig_cmp(buffer, 0, sizeof(buffer)) == 0) {
-    pixels_image = read_png_file(file);
-  } // Compare with jpg signature
-  else if (buffer[0] == 0xFF && buffer[1] == 0xD8 && buffer[2] == 0xFF) {
-    pixels_image = read_jpg_file(file);
-  } // Compare with bmp signature
-  else if (buffer[0] == 'B' && buffer[1] == 'M') {
-    pixels_image = read_bmp_file(file);
-  } // Compare with heif signature
-  else {
-    fclose(file);
-    printf("Unsupported file format.\n");
-    exit(EXIT_FAILURE_USUPPORTED_FILE_FORMAT);
+  // Everything a frame needs is allowed before the first one
+  colorflow_result result;
+  int *zone_RGBA = (int*)malloc((4*zoneAmount(zones) + 1)*sizeof(int));
+  int *histogram = (int*)calloc(LATENCY_BUCKETS, sizeof(int));
+  if(!zone_RGBA || !histogram){
+    displayError(NULL, EXIT_FAILURE_MALLOC);
+    exit(EXIT_FAILURE_MALLOC);
   }
-  return pixels_image;
-}
+  file_job job;
+  memset(&job, 0, sizeof(job));
+  job.filename = "-";
+  job.sampled = options->sample_stride > 1 || options->sample_budget > 0;
+  job.results = &result;
+  job.zone_RGBA = zone_RGBA;
+  percentage_list percentage = {1, NULL, &options->frame_percentage};
+
+  int frame_amount = 0;
+  long long longest = 0;
+  while((code = colorflow_stream_read(&stream)) == COLORFLOW_OK){
+    long long start = getMicroseconds();
+    job.code = colorflow_stream_compute(ctx, &stream, options, zones->top_amount, zones->side_amount, zone_RGBA, &result);
+    long long time = getMicroseconds() - start;
+    if(job.code != COLORFLOW_OK){
+      code = job.code;
+      break;
+    }
 
-/// @brief displays help message to the user
-void displayHelp(){
+    histogram[time < LATENCY_BUCKETS ? time : LATENCY_BUCKETS - 1]++;
+    if(time > longest){
+      longest = time;
+    }
+    frame_amount++;
 
-  if(debug_mode){
-    displayDebugInfo("void displayHelp()");
+    displayResult(&job, &percentage, zones, 0);
+    // The colors are used as soon as they are displayed
+    fflush(stdout);
   }
-
-  char* filename = "help.txt";
-  FILE *file = fopen(filename, "rt");
-  if(!file){
-    fprintf(stderr,"Error while opening file %s\n", filename);
-    perror("open");
-    exit(EXIT_FAILURE_OPEN_FAILED);
+  if(code == COLORFLOW_END_OF_STREAM){
+    code = COLORFLOW_OK;
   }
-  char c; 
-  while((c=fgetc(file))!=EOF){
-    printf("%c",c);
+  else{
+    displayError("-", code);
   }
-  fclose(file);
+
+  if(frame_amount > 0){
+    fprintf(stderr, "%d frames, p50 %d us, p99 %d us, max %lld us\n", frame_amount, getPercentile(histogram, frame_amount, 0.5), getPercentile(histogram, frame_amount, 0.99), longest);
+  }
+
+  // Free ressources
+  free(histogram);
+  free(zone_RGBA);
+  colorflow_stream_close(&stream);
+  return code;
 }
 
 
 int main(int argc, char *argv[]) {
-  struct stat sb;
   if(argc == 1){
     fprintf(stderr,"Error: colorflow needs arguments\n\nRun \"colorflow -h\" to get more details\n");
     exit(EXIT_FAILURE_NEEDS_ARGUMENT);
   }
   // Parsing command line arguments
   int opt;
-  char* filename;
-  int percentage = -1 ;
+  int file_capacity = argc;
+  char** filenames = (char**)malloc(file_capacity*sizeof(char*));
+  int file_amount = 0;
+  char* list_filename = NULL;
+  percentage_list percentages = {0, NULL, NULL};
+  zone_layout zones = {0, 0};
+  int thread_amount = 1;
+  int unordered = 0;
+  size_t memory_budget = 0;
+  int fast_jpeg = COLORFLOW_JPEG_EXACT;
+  char* cache_filename = NULL;
+  int dedup = 0;
+  char* serve_path = NULL;
+  char* client_path = NULL;
+  int threads_given = 0;
+  int stream_format = -1;
+  int stream_width = 0;
+  int stream_height = 0;
+  int profile_format = 0;
+  char* trace_filename = NULL;
+  int sample_stride = 0;
+  long long sample_budget = 0;
+  int debug_mode = 0;
+
+  if(!filenames){
+    displayError(NULL, EXIT_FAILURE_MALLOC);
+    exit(EXIT_FAILURE_MALLOC);
+  }
+
+  static struct option long_options[] = {
+    {"unordered", no_argument, NULL, 'u'},
+    {"zones", required_argument, NULL, 'z'},
+    {"y4m", no_argument, NULL, 'y'},
+    {"rgba", required_argument, NULL, 'r'},
+    {"fast-jpeg", required_argument, NULL, 'J'},
+    {"cache", required_argument, NULL, 'c'},
+    {"dedup", no_argument, NULL, 'D'},
+    {"serve", required_argument, NULL, 'S'},
+    {"client", required_argument, NULL, 'C'},
+    {"profile", optional_argument, NULL, 'P'},
+    {"trace", required_argument, NULL, 'T'},
+    {"sample", required_argument, NULL, 's'},
+    {"sample-budget", required_argument, NULL, 'b'},
+    {NULL, 0, NULL, 0}
+  };
 
-  while((opt = getopt(argc, argv, "dh?f:n:")) != -1){
+  while((opt = getopt_long(argc, argv, "dh?f:n:@:j:m:", long_options, NULL)) != -1){
     switch(opt){
       case 'f':
-        filename = optarg;
+        filenames[file_amount++] = optarg;
         break;
       case 'n':
-        percentage = atoi(optarg);
+        parsePercentages(optarg, &percentages);
+        break;
+      case '@':
+        list_filename = optarg;
+        break;
+      case 'j':
+        thread_amount = atoi(optarg);
+        threads_given = 1;
+        if(thread_amount <= 0){
+          // -j 0 uses every online processor
+          thread_amount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+          if(thread_amount <= 0){
+            thread_amount = 1;
+          }
+        }
+        break;
+      case 'u':
+        unordered = 1;
+        break;
+      case 'm':
+        memory_budget = (size_t)atol(optarg) * 1024 * 1024;
+        break;
+      case 'z':
+        parseZones(optarg, &zones);
+        break;
+      case 'c':
+        cache_filename = optarg;
+        break;
+      case 'D':
+        dedup = 1;
+        break;
+      case 'S':
+        serve_path = optarg;
+        break;
+      case 'C':
+        client_path = optarg;
+        break;
+      case 'J':
+        if(strcmp(optarg, "scaled") == 0){
+          fast_jpeg = COLORFLOW_JPEG_SCALED;
+        }
+        else if(strcmp(optarg, "dc") == 0){
+          fast_jpeg = COLORFLOW_JPEG_DC;
+        }
+        else{
+          fprintf(stderr,"Error: --fast-jpeg needs an approximation, scaled or dc\n");
+          exit(EXIT_FAILURE_NEEDS_ARGUMENT);
+        }
+        break;
+      case 'P':
+        if(!optarg || strcmp(optarg, "text") == 0){
+          profile_format = PROFILE_TEXT;
+        }
+        else if(strcmp(optarg, "json") == 0){
+          profile_format = PROFILE_JSON;
+        }
+        else{
+          fprintf(stderr,"Error: --profile displays the stages as text or json\n");
+          exit(EXIT_FAILURE_NEEDS_ARGUMENT);
+        }
+        break;
+      case 'T':
+        trace_filename = optarg;
+        break;
+      case 's':
+        sample_stride = atoi(optarg);
+        if(sample_stride < 1){
+          fprintf(stderr,"Error: --sample needs a stride of at least 1\n");
+          exit(EXIT_FAILURE_NEEDS_ARGUMENT);
+        }
+        break;
+      case 'b':
+        sample_budget = atoll(optarg);
+        if(sample_budget < 1){
+          fprintf(stderr,"Error: --sample-budget needs a number of pixels of at least 1\n");
+          exit(EXIT_FAILURE_NEEDS_ARGUMENT);
+        }
+        break;
+      case 'y':
+        stream_format = COLORFLOW_STREAM_Y4M;
+        break;
+      case 'r':
+        stream_format = COLORFLOW_STREAM_RGBA;
+        if(sscanf(optarg, "%dx%d", &stream_width, &stream_height) != 2 || stream_width <= 0 || stream_height <= 0){
+          fprintf(stderr,"Error: --rgba needs the dimensions of the frames, WIDTHxHEIGHT\n");
+          exit(EXIT_FAILURE_NEEDS_ARGUMENT);
+        }
         break;
       case 'h':
       case '?':
-        displayHelp();
+        displayHelp(debug_mode);
         return 0;
       case 'd':
         debug_mode = 1;
@@ -487,54 +1489,192 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  FILE *file = fopen(filename, "rb");
-  if(!file){
-    fprintf(stderr,"Error while opening file %s\n", filename);
-    perror("open");
-    exit(EXIT_FAILURE_OPEN_FAILED);
-  } 
+  // Files can also be given without -f
+  for(int i = optind; i < argc; i++){
+    filenames[file_amount++] = argv[i];
+  }
 
-  if (stat(filename, &sb)) {
-    perror(filename);
-    exit(EXIT_FAILURE_BAD_FILE);
+  if(file_amount == 0 && !list_filename && stream_format == -1 && !serve_path){
+    fprintf(stderr,"Error: colorflow needs a file\n\nRun \"colorflow -h\" to get more details\n");
+    exit(EXIT_FAILURE_NEEDS_ARGUMENT);
   }
-  size = sb.st_size;
 
-  // Reading the first bytes of the binary file and store it in an array 
-  unsigned char buffer[8];
-  int read_len = fread(buffer, 1, sizeof(buffer), file);
-  if(read_len != 8){
-    fclose(file);
-    fprintf(stderr,"Error while reading file %s\n", filename);
-    exit(EXIT_FAILURE_BAD_FILE);
+  if(percentages.amount == 0){
+    parsePercentages("10", &percentages); // setting default value
+  }
+  colorflow_options options;
+  options.frame_percentage = percentages.values[0];
+  options.debug_mode = debug_mode;
+  options.memory_budget = memory_budget;
+  options.fast_jpeg = fast_jpeg;
+  options.sample_stride = sample_stride;
+  options.sample_budget = (size_t)sample_budget;
+
+  // The zones are computed on a single frame
+  if(zones.top_amount && percentages.amount > 1){
+    displayError(NULL, EXIT_FAILURE_BAD_ZONES);
+    exit(EXIT_FAILURE_BAD_ZONES);
   }
 
-  // Reseting the pointer at the begining of the file
-  int seek = fseek(file,0,SEEK_SET);
-  if(seek){
-    fclose(file);
-    perror("seek");
-    exit(EXIT_FAILURE_BAD_FILE);
+  // The frame tables and the zones sum every pixel, the cache only keeps exact colors, and the answers of the server have no standard error
+  if((sample_stride || sample_budget) && ((sample_stride && sample_budget) || percentages.amount > 1 || zones.top_amount || cache_filename || serve_path || client_path)){
+    fprintf(stderr,"Error: --sample and --sample-budget cannot be combined, nor used with several percentages, --zones, --cache, --serve or --client\n");
+    exit(EXIT_FAILURE_NEEDS_ARGUMENT);
   }
 
-  pixel** pixels_image = read_data(file, buffer);
+  // A video stream is read from the standard input instead of files
+  if(stream_format != -1){
+    if(percentages.amount > 1){
+      displayError(NULL, EXIT_FAILURE_BAD_PERCENTAGE);
+      exit(EXIT_FAILURE_BAD_PERCENTAGE);
+    }
+    colorflow_ctx *ctx = colorflow_ctx_create();
+    if(!ctx){
+      displayError(NULL, EXIT_FAILURE_MALLOC);
+      exit(EXIT_FAILURE_MALLOC);
+    }
+    int exit_code = processStream(ctx, stream_format, stream_width, stream_height, &options, &zones);
+    colorflow_ctx_destroy(ctx);
+    free(filenames);
+    free(percentages.numbers);
+    free(percentages.values);
+    return exit_code;
+  }
 
-  fclose(file);
+  FILE *list = NULL;
+  if(list_filename){
+    list = strcmp(list_filename, "-") == 0 ? stdin : fopen(list_filename, "r");
+    if(!list){
+      fprintf(stderr,"Error while opening file %s\n", list_filename);
+      perror("open");
+      exit(EXIT_FAILURE_OPEN_FAILED);
+    }
+  }
+
+  // The name of the file is displayed as soon as there can be more than one
+  int batch_mode = file_amount > 1 || list_filename;
 
-  if(percentage == -1){
-    percentage = 10; // setting default value
+  // The files are computed by a server, with its own options
+  if(client_path){
+    int exit_code = processClient(client_path, filenames, file_amount, list, &percentages, batch_mode);
+    if(list && list != stdin){
+      fclose(list);
+    }
+    free(filenames);
+    free(percentages.numbers);
+    free(percentages.values);
+    return exit_code;
   }
-  float frame_percentage = (float)(percentage/100.0);
-  if(frame_percentage > 1.0 || frame_percentage <= 0.0){
-    fprintf(stderr,"Error : frame_percentage must be a value between 0 and 100\n");
-    exit(EXIT_FAILURE_BAD_PERCENTAGE);
+
+  // Colors of the files computed by previous runs
+  result_cache cache_storage;
+  result_cache *cache = NULL;
+  if(cache_filename){
+    if(openCache(&cache_storage, cache_filename) != 0){
+      fprintf(stderr,"Error while opening cache file %s\n", cache_filename);
+      perror("open");
+      exit(EXIT_FAILURE_OPEN_FAILED);
+    }
+    cache = &cache_storage;
   }
 
-  int* average_RGBA = getAverageColor(pixels_image, frame_percentage);
-  printf("%02X%02X%02X-%02X\n",average_RGBA[0],average_RGBA[1],average_RGBA[2],average_RGBA[3]);
+  // Stage times of the files, the run starts once the options are read
+  profile_report report;
+  memset(&report, 0, sizeof(report));
+  report.format = profile_format;
+  report.start = getNanoseconds();
+  profile_report *profile = (profile_format || trace_filename) && !serve_path ? &report : NULL;
+
+  // Spans of every worker, written to the trace file once the files are computed
+  trace_recorder trace;
+  if(profile && trace_filename){
+    if(openTrace(&trace, thread_amount, TRACE_CAPACITY) != 0){
+      displayError(NULL, EXIT_FAILURE_MALLOC);
+      exit(EXIT_FAILURE_MALLOC);
+    }
+    report.trace = &trace;
+  }
 
-  // Free ressources 
-  free(pixels_image);
+  int exit_code = 0;
+  // Names read from the list after this one are allocated
+  int given_amount = file_amount;
+
+  if(serve_path){
+    // A server uses every processor unless told otherwise
+    if(!threads_given){
+      thread_amount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+      if(thread_amount <= 0){
+        thread_amount = 1;
+      }
+    }
+    exit_code = processServer(serve_path, thread_amount, &options, &percentages, &zones, cache);
+  }
+  else if(thread_amount > 1 || dedup){
+    // The threads, and the search of the identical files, need every name before they start, so the list is read first
+    if(list){
+      appendList(list, &filenames, &file_amount, &file_capacity);
+    }
+    exit_code = processFiles(filenames, file_amount, thread_amount, &options, &percentages, &zones, cache, batch_mode, unordered, dedup, profile);
+  }
+  else{
+    // The same context, with its buffers and decoders, is used for every file
+    colorflow_ctx *ctx = colorflow_ctx_create();
+    if(!ctx){
+      displayError(NULL, EXIT_FAILURE_MALLOC);
+      exit(EXIT_FAILURE_MALLOC);
+    }
+    // The spans of a trace point to the names of their files, which are kept until the trace is written
+    if(list && report.trace){
+      appendList(list, &filenames, &file_amount, &file_capacity);
+    }
+    for(int i = 0; i < file_amount; i++){
+      int code = processFile(ctx, filenames[i], &options, &percentages, &zones, cache, batch_mode, profile);
+      if(code && !exit_code){
+        exit_code = code;
+      }
+    }
+    if(list && !report.trace){
+      int code = processList(ctx, list, &options, &percentages, &zones, cache, profile);
+      if(code && !exit_code){
+        exit_code = code;
+      }
+    }
+    colorflow_ctx_destroy(ctx);
+  }
 
-  return 0;
-}
\ No newline at end of file
+  if(profile && profile_format){
+    displayProfileSummary(profile);
+  }
+  if(report.trace){
+    long long lost = writeTrace(report.trace, trace_filename);
+    if(lost < 0){
+      fprintf(stderr,"Error while writing trace file %s\n", trace_filename);
+      perror("write");
+      if(!exit_code){
+        exit_code = EXIT_FAILURE_OPEN_FAILED;
+      }
+    }
+    else if(lost > 0){
+      fprintf(stderr,"%lld spans lost, the oldest ones of the workers with more than %d spans\n", lost, TRACE_CAPACITY);
+    }
+    closeTrace(report.trace);
+  }
+
+  if(cache){
+    fprintf(stderr,"%llu cache hits, %llu cache misses\n", (unsigned long long)cache->hits, (unsigned long long)cache->misses);
+    closeCache(cache);
+  }
+
+  // Free ressources
+  if(list && list != stdin){
+    fclose(list);
+  }
+  for(int i = given_amount; i < file_amount; i++){
+    free(filenames[i]);
+  }
+  free(filenames);
+  free(percentages.numbers);
+  free(percentages.values);
+
+  return exit_code;
+}
@@ -0,0 +1,145 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "include/hash.h"
+
+// Primes of the XXH64 algorithm, https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static uint64_t rotateLeft(uint64_t value, int bits){
+  return (value << bits) | (value >> (64 - bits));
+}
+
+/// @brief read 8 bytes in little endian order, at any alignment
+static uint64_t read64(const unsigned char *bytes){
+  uint64_t value;
+  memcpy(&value, bytes, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  value = __builtin_bswap64(value);
+#endif
+  return value;
+}
+
+/// @brief read 4 bytes in little endian order, at any alignment
+static uint32_t read32(const unsigned char *bytes){
+  uint32_t value;
+  memcpy(&value, bytes, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  value = __builtin_bswap32(value);
+#endif
+  return value;
+}
+
+/// @brief add 8 bytes of input to an accumulator
+static uint64_t hashRound(uint64_t accumulator, uint64_t input){
+  accumulator += input*PRIME64_2;
+  accumulator = rotateLeft(accumulator, 31);
+  return accumulator*PRIME64_1;
+}
+
+/// @brief merge one of the 4 accumulators into the hash
+static uint64_t mergeRound(uint64_t hash, uint64_t accumulator){
+  hash ^= hashRound(0, accumulator);
+  return hash*PRIME64_1 + PRIME64_4;
+}
+
+/// @brief XXH64 hash of a buffer
+/// @param data bytes to hash
+/// @param size number of bytes
+/// @param seed seed of the hash, 0 gives the usual XXH64 values
+/// @return hash of the bytes
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed){
+  const unsigned char *bytes = (const unsigned char*)data;
+  const unsigned char *end = bytes + size;
+  uint64_t hash;
+
+  // 4 independent accumulators on stripes of 32 bytes
+  if(size >= 32){
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+    const unsigned char *limit = end - 32;
+    do{
+      v1 = hashRound(v1, read64(bytes));
+      v2 = hashRound(v2, read64(bytes + 8));
+      v3 = hashRound(v3, read64(bytes + 16));
+      v4 = hashRound(v4, read64(bytes + 24));
+      bytes += 32;
+    } while(bytes <= limit);
+    hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+    hash = mergeRound(hash, v1);
+    hash = mergeRound(hash, v2);
+    hash = mergeRound(hash, v3);
+    hash = mergeRound(hash, v4);
+  }
+  else{
+    hash = seed + PRIME64_5;
+  }
+  hash += (uint64_t)size;
+
+  // Last bytes, 8 then 4 then 1 at a time
+  while(bytes + 8 <= end){
+    hash ^= hashRound(0, read64(bytes));
+    hash = rotateLeft(hash, 27)*PRIME64_1 + PRIME64_4;
+    bytes += 8;
+  }
+  if(bytes + 4 <= end){
+    hash ^= (uint64_t)read32(bytes)*PRIME64_1;
+    hash = rotateLeft(hash, 23)*PRIME64_2 + PRIME64_3;
+    bytes += 4;
+  }
+  while(bytes < end){
+    hash ^= (*bytes)*PRIME64_5;
+    hash = rotateLeft(hash, 11)*PRIME64_1;
+    bytes++;
+  }
+
+  // Avalanche
+  hash ^= hash >> 33;
+  hash *= PRIME64_2;
+  hash ^= hash >> 29;
+  hash *= PRIME64_3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+/// @brief XXH64 hash of the content of a file
+/// @param path path of the file
+/// @param hash hash of the content, set on success
+/// @param size size of the file, set on success
+/// @return 0, or -1 with errno set if the file could not be read
+int hashFile(const char *path, uint64_t *hash, uint64_t *size){
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if(fd < 0){
+    return -1;
+  }
+  struct stat info;
+  if(fstat(fd, &info) != 0){
+    close(fd);
+    return -1;
+  }
+  *size = info.st_size;
+  if(info.st_size == 0){
+    close(fd);
+    *hash = hashBytes(NULL, 0, 0);
+    return 0;
+  }
+
+  // The kernel reads ahead of the pages being hashed, the reading overlaps the hashing
+  void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED){
+    return -1;
+  }
+  madvise(map, info.st_size, MADV_SEQUENTIAL);
+  *hash = hashBytes(map, info.st_size, 0);
+  munmap(map, info.st_size);
+  return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+// Identity of a file and of the computation of one of its colors, the size and the modification time invalidate the entries of a modified file
+// The slot of a key is chosen without its size and modification time, so that a new version of a file finds the entry of the old one
+typedef struct{
+  uint64_t device;
+  uint64_t inode;
+  uint64_t size;
+  uint64_t mtime_ns;
+  float frame_percentage;
+  uint32_t mode;          // options that change the colors, such as the JPEG approximation
+} cache_key;
+
+// Result cache stored in a memory mapped file, shared by the threads of a process and by several processes
+typedef struct{
+  int fd;
+  struct cache_header *header;
+  struct cache_entry *entries;
+  uint32_t entry_amount;
+  pthread_mutex_t write_lock;     // the file lock is held by the process, the threads of a process also wait for each other
+  uint64_t hits;                  // counted by every thread with atomic additions
+  uint64_t misses;
+} result_cache;
+
+// Open the cache file path, which is created when it does not exist
+// Returns 0, or -1 with errno set if the file could not be opened or is not a cache file
+int openCache(result_cache *cache, const char *path);
+
+// Fill key with the identity of the file path, returns 0 or -1 if the file could not be read
+int getCacheKey(cache_key *key, const char *path, float frame_percentage, uint32_t mode);
+
+// Look up a color, returns 1 and fills width, height and average_RGBA on a hit, 0 on a miss
+// The lookup takes no lock, an entry being written is a miss
+int lookupCache(result_cache *cache, const cache_key *key, int *width, int *height, int *average_RGBA);
+
+// Store a color, an older entry of the same file and computation is replaced, every version of a file probes the same entries
+void storeCache(result_cache *cache, const cache_key *key, int width, int height, const int *average_RGBA);
+
+void closeCache(result_cache *cache);
+
+#endif
@@ -1,6 +1,32 @@
 #ifndef _COVERFLOW_H_
 #define _COVERFLOW_H_
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Error codes returned by libcolorflow, they are also the exit codes of the colorflow program
+#define COLORFLOW_OK 0
+#define COLORFLOW_ERROR_OPEN_FAILED 1
+#define COLORFLOW_ERROR_BAD_FILE 2
+#define COLORFLOW_ERROR_UNSUPPORTED_FILE_FORMAT 3
+#define COLORFLOW_ERROR_MALLOC 4
+#define COLORFLOW_ERROR_BAD_PERCENTAGE 5
+#define COLORFLOW_ERROR_BAD_ZONES 8       // 6 and 7 are exit codes of the colorflow program
+#define COLORFLOW_ERROR_MEMORY_BUDGET 9
+
+// Returned by colorflow_stream_read once every frame has been read, it is not an error
+#define COLORFLOW_END_OF_STREAM -1
+
+// Formats of the video streams
+#define COLORFLOW_STREAM_RGBA 0     // raw RGBA frames, their dimensions are given by the caller
+#define COLORFLOW_STREAM_Y4M 1      // YUV4MPEG2 frames, their dimensions are read from the header of the stream
+
+// Approximations of the frame of JPEG pictures, for previews
+#define COLORFLOW_JPEG_EXACT 0      // every pixel is decoded
+#define COLORFLOW_JPEG_SCALED 1     // the picture is decoded by the library at 1/8, 1/4 or 1/2 of its size
+#define COLORFLOW_JPEG_DC 2         // only the DC coefficients are read, each 8x8 block is decoded as its mean
+
 typedef struct{
     unsigned char red;
     unsigned char green;
@@ -8,5 +34,176 @@ typedef struct{
     unsigned char alpha;
 } pixel;
 
+// Options of a computation
+typedef struct{
+    float frame_percentage;     // percentage of the border, in ]0, 1]
+    int debug_mode;             // print the called functions on the standard output
+    size_t memory_budget;       // largest matrix of pixels a picture decoded entirely may need, in bytes, 0 for no limit
+    int fast_jpeg;              // COLORFLOW_JPEG_EXACT, or an approximation of the frame of JPEG pictures
+    int sample_stride;          // sum one row and one column in sample_stride of the frame, 0 or 1 to sum every pixel
+    size_t sample_budget;       // largest number of pixels of the frame summed, which sets the stride of each picture, 0 for no limit
+} colorflow_options;
+
+// Stages of the computation of a picture, timed when the context has a profile
+#define COLORFLOW_STAGE_OPEN 0          // opening the file and reading its size, closing it
+#define COLORFLOW_STAGE_SNIFF 1         // reading the signature of the format
+#define COLORFLOW_STAGE_HEADER 2        // reading the header of the picture and setting up the decoder
+#define COLORFLOW_STAGE_SCANLINES 3     // decompressing the rows, libpng converts them to RGBA at the same time
+#define COLORFLOW_STAGE_REPACK 4        // converting the decoded rows into RGBA pixels
+#define COLORFLOW_STAGE_ACCUMULATE 5    // summing the borders, the frame tables and the zones
+#define COLORFLOW_STAGE_OUTPUT 6        // displaying the results, timed by the program
+#define COLORFLOW_STAGE_AMOUNT 7
+
+// Time spent in each stage and bytes it has read or produced, every computation of a context adds to the profile of the context
+typedef struct colorflow_profile{
+    int64_t nanoseconds[COLORFLOW_STAGE_AMOUNT];    // monotonic clock
+    int64_t bytes[COLORFLOW_STAGE_AMOUNT];          // size of the file, of the signature, of the decoded rows or of the rows summed
+    int64_t start;                                  // time the first computation started at, 0 before it
+    int64_t end[COLORFLOW_STAGE_AMOUNT];            // time each stage was last timed at, 0 if it never was
+} colorflow_profile;
+
+// Result of a computation
+typedef struct{
+    int width;
+    int height;
+    int average_RGBA[4];
+    float standard_error[4];    // estimated error of each component of average_RGBA when the frame is sampled, 0 otherwise
+} colorflow_result;
+
+// State of the computations of one thread, it keeps its buffers from one picture to the next
+typedef struct{
+    int width;                  // dimensions of the current picture
+    int height;
+    size_t size;                // size of the current file in bytes
+    const unsigned char *data;  // current picture when it is read from memory, NULL when it is read from a file
+    size_t data_offset;         // number of bytes of data already given to libpng
+    colorflow_options options;
+    pixel *row;                 // row buffer of the streaming decoders, 64 byte aligned
+    size_t row_capacity;        // number of pixels allowed for row
+    pixel *pixels;              // RGBA picture of the full decoders, 64 byte aligned, row y starts at pixels + y*stride
+    size_t stride;              // number of pixels from one row of pixels to the next
+    size_t pixels_capacity;     // number of bytes allowed for pixels
+    void *decoders;             // decoder structures reused from one picture to the next
+    struct frame_table *table;  // table filled by the decoders instead of the average color, NULL for a single percentage
+    int64_t *table_sums;        // sums of the frame tables
+    size_t table_capacity;      // number of sums allowed for table_sums
+    struct zone_accumulator *zones;     // zones filled by the decoders along with the borders, NULL without zones
+    int64_t *zone_sums;         // sums of the zones
+    size_t zone_capacity;       // number of sums allowed for zone_sums
+    colorflow_profile *profile; // stages timed during the computations, NULL to not time them
+    int64_t profile_lap;        // time the current stage started at
+    float standard_error[4];    // estimated error of the last average color computed from a sampled frame, 0 otherwise
+} colorflow_ctx;
+
+// Running sums of the four borders of a picture, filled one row at a time
+typedef struct{
+    int width;
+    int height;
+    int up_end;         // rows [0, up_end) belong to the upper border
+    int right_start;    // columns [right_start, width) belong to the right border
+    int down_start;     // rows [down_start, height) belong to the lower border
+    int left_end;       // columns [0, left_end) belong to the left border
+    int64_t up[4];      // sums on 64 bits, a border of a gigapixel picture overflows 32 bits
+    int64_t right[4];
+    int64_t down[4];
+    int64_t left[4];
+    int stride;         // one row and one column in stride are summed, the multiples of stride, 1 to sum every pixel
+    int64_t samples[4];     // number of pixels summed in the upper, right, lower and left borders, with a stride
+    int64_t squares[16];    // sums of the squares of the RGBA values summed, 4 per border in the same order, with a stride
+    struct frame_table *table;  // when set, the rows are added to this table instead of the sums
+    struct zone_accumulator *zones;     // when set, the rows are added to these zones instead of the sums
+} border_accumulator;
+
+// Running sums of the zones the four borders of a picture are split into, for lights placed around a screen
+// The upper and lower borders are split along their columns, the left and right borders along their rows
+typedef struct zone_accumulator{
+    int top_amount;     // number of zones of the upper and lower borders
+    int side_amount;    // number of zones of the left and right borders
+    int width;          // bounds of the frame, as in border_accumulator
+    int height;
+    int up_end;
+    int right_start;
+    int down_start;
+    int left_end;
+    int64_t *up;        // RGBA sums of every zone, from left to right
+    int64_t *right;     // from top to bottom
+    int64_t *down;      // from left to right
+    int64_t *left;      // from top to bottom
+} zone_accumulator;
+
+// Prefix sums of the rows and columns of the widest frame of a picture, every narrower frame is read from them
+typedef struct frame_table{
+    int width;
+    int height;
+    int up_end;         // bounds of the widest frame, as in border_accumulator
+    int right_start;
+    int down_start;
+    int left_end;
+    int64_t *up;        // up[4*k..4*k+3] are the RGBA sums of rows [0, k)
+    int64_t *right;     // right[4*k..4*k+3] are the RGBA sums of columns [width-k, width)
+    int64_t *down;      // down[4*k..4*k+3] are the RGBA sums of rows [height-k, height)
+    int64_t *left;      // left[4*k..4*k+3] are the RGBA sums of columns [0, k)
+    float smallest_percentage;  // smallest percentage read from the table, set before the picture is decoded
+} frame_table;
+
+// Video stream whose frames are read one after the other into the same buffer
+typedef struct{
+    FILE *file;
+    int format;
+    int width;
+    int height;
+    int chroma;             // the frames of a Y4M stream have U and V planes
+    int chroma_x_shift;     // a U or V sample covers 2^chroma_x_shift columns and 2^chroma_y_shift rows
+    int chroma_y_shift;
+    size_t frame_size;      // number of bytes of a frame
+    unsigned char *frame;   // last frame read
+} colorflow_stream;
+
+// Contexts
+colorflow_ctx *colorflow_ctx_create(void);
+void colorflow_ctx_destroy(colorflow_ctx *ctx);
+
+// Average color of the frame of the picture stored in the file path
+int colorflow_compute(colorflow_ctx *ctx, const char *path, const colorflow_options *opts, colorflow_result *out);
+
+// Average colors of the frames of several percentages of the picture stored in the file path, which is decoded once
+// out holds one result per percentage
+int colorflow_compute_percentages(colorflow_ctx *ctx, const char *path, const colorflow_options *opts, const float *frame_percentages, int percentage_amount, colorflow_result *out);
+
+// Average colors of the zones of the frame of the picture stored in the file path, and of the whole frame
+// zone_RGBA holds 4 values for each of the 2*top_amount + 2*side_amount zones, clockwise from the top left corner
+int colorflow_compute_zones(colorflow_ctx *ctx, const char *path, const colorflow_options *opts, int top_amount, int side_amount, int *zone_RGBA, colorflow_result *out);
+
+// Same computations on a picture stored in memory, such as a picture read from a pipe, data is not copied and must stay valid during the call
+int colorflow_compute_memory(colorflow_ctx *ctx, const void *data, size_t size, const colorflow_options *opts, colorflow_result *out);
+int colorflow_compute_percentages_memory(colorflow_ctx *ctx, const void *data, size_t size, const colorflow_options *opts, const float *frame_percentages, int percentage_amount, colorflow_result *out);
+int colorflow_compute_zones_memory(colorflow_ctx *ctx, const void *data, size_t size, const colorflow_options *opts, int top_amount, int side_amount, int *zone_RGBA, colorflow_result *out);
+
+// Video streams, the frames are computed without allocating memory
+int colorflow_stream_open(colorflow_stream *stream, FILE *file, int format, int width, int height);
+int colorflow_stream_read(colorflow_stream *stream);
+// Average color of the frame of the last frame read, and of its zones when top_amount is not 0
+int colorflow_stream_compute(colorflow_ctx *ctx, colorflow_stream *stream, const colorflow_options *opts, int top_amount, int side_amount, int *zone_RGBA, colorflow_result *out);
+void colorflow_stream_close(colorflow_stream *stream);
+
+// Decode the whole picture stored in the file path into ctx->pixels, whose rows are ctx->stride pixels apart
+int colorflow_decode(colorflow_ctx *ctx, const char *path, const colorflow_options *opts);
+int colorflow_decode_memory(colorflow_ctx *ctx, const void *data, size_t size, const colorflow_options *opts);
+
+// Pixels and borders
+pixel createPixel(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+void initBorderAccumulator(colorflow_ctx *ctx, border_accumulator *accumulator, float frame_percentage);
+void sumRow(int64_t *sums, pixel *row, int start_column, int end_column);
+const char *sumKernelName(void);
+int selectSumKernel(const char *name);
+void accumulateRow(border_accumulator *accumulator, int y, pixel *row);
+void computeAverageColor(colorflow_ctx *ctx, border_accumulator *accumulator, int *average_RGBA);
+int initFrameTable(colorflow_ctx *ctx, frame_table *table, border_accumulator *accumulator);
+void finishFrameTable(frame_table *table);
+void readFrameTable(colorflow_ctx *ctx, frame_table *table, float frame_percentage, int *average_RGBA);
+int initZoneAccumulator(colorflow_ctx *ctx, zone_accumulator *zones, border_accumulator *accumulator, int top_amount, int side_amount);
+void computeZoneColors(colorflow_ctx *ctx, zone_accumulator *zones, int *zone_RGBA);
+void getAverageBorderColor(colorflow_ctx *ctx, pixel *pixels_image, size_t stride, int *border_average_color, int start_row, int end_row, int start_column, int end_column);
+void getAverageColor(colorflow_ctx *ctx, pixel *pixels_image, size_t stride, float frame_percentage, int *average_RGBA);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,14 @@
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// XXH64 hash of a buffer, a fast non-cryptographic hash
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed);
+
+// XXH64 hash of the content of the file path, read through a sequential memory mapping
+// Returns 0, or -1 with errno set if the file could not be read
+int hashFile(const char *path, uint64_t *hash, uint64_t *size);
+
+#endif
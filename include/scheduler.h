@@ -0,0 +1,12 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+// Function called for every job, thread is the index of the worker in [0, thread_amount)
+typedef void (*scheduler_work)(int thread, int job, void *data);
+
+// Run the jobs [0, job_amount) on thread_amount workers with work stealing
+// The calling thread is one of the workers, so every job is run even if no other thread can be started
+// Returns 0, or -1 if the deques could not be allocated
+int runJobs(int job_amount, int thread_amount, scheduler_work work, void *data);
+
+#endif
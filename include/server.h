@@ -0,0 +1,33 @@
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+#include <stdio.h>
+
+// Function called by a worker for every request, a line without its newline, worker is the index of the worker in [0, worker_amount)
+// Returns the answer, a line without its newline allocated with malloc, or NULL to close the connection of the client
+typedef char* (*server_work)(int worker, char *request, void *data);
+
+// Serve the UNIX domain socket path until SIGINT or SIGTERM, with worker_amount workers computing the requests
+// Every client can send several requests without waiting, it receives the answers in the order of its requests
+// Returns 0 once stopped, or -1 with errno set if the socket could not be served
+int runServer(const char *path, int worker_amount, server_work work, void *data);
+
+// Connection of a client to a server
+typedef struct{
+  int fd;
+  FILE *requests;       // buffered, flushed before waiting for an answer
+  FILE *answers;
+} server_connection;
+
+// Connect to the server of the socket path, returns 0 or -1 with errno set
+int connectServer(server_connection *connection, const char *path);
+
+// Send a request, which must not contain a newline, returns 0 or -1 if the server is gone
+int sendRequest(server_connection *connection, const char *request);
+
+// Wait for the answer of the oldest request, stored in buffer without its newline, NULL if the server is gone
+char* readAnswer(server_connection *connection, char **buffer, size_t *capacity);
+
+void disconnectServer(server_connection *connection);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Span of a trace, a complete event of the Chrome trace event format
+typedef struct{
+  const char *name;       // name of the span, a string that outlives the trace
+  int64_t start;          // monotonic clock, in nanoseconds
+  int64_t end;
+  const char *file;       // name of the file the span belongs to, NULL for none, kept by the caller until the trace is written
+  int width;              // dimensions of the picture, 0 when they are unknown
+  int height;
+  const char *value_name; // name of an extra number of the span, NULL for none
+  int64_t value;
+} trace_span;
+
+// Spans of one thread, written by this thread only, the oldest ones are overwritten once it is full
+typedef struct{
+  trace_span *spans;
+  size_t capacity;
+  uint64_t written;       // number of spans added, the last capacity ones are kept
+} trace_ring;
+
+// Spans of every thread of a run, written to a file at the end
+typedef struct{
+  trace_ring *rings;
+  int thread_amount;
+  int64_t origin;         // time the trace started at, the spans are written relative to it
+} trace_recorder;
+
+// Allocate a ring of capacity spans for each of thread_amount threads, returns 0 or -1 if the memory could not be allocated
+int openTrace(trace_recorder *trace, int thread_amount, size_t capacity);
+
+// Add a span to the ring of a thread, each thread adds to its own ring without any lock nor allocation
+void addTraceSpan(trace_recorder *trace, int thread, const trace_span *span);
+
+// Write the spans kept by every ring to path, as a JSON trace opened by chrome://tracing and Perfetto
+// Returns the number of spans lost because a ring was full, or -1 with errno set if the file could not be written
+long long writeTrace(trace_recorder *trace, const char *path);
+
+void closeTrace(trace_recorder *trace);
+
+#endif
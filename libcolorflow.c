@@ -0,0 +1,2638 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include <math.h>
+#include <assert.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "include/png.h"
+#include "include/jpeglib.h"
+#include "include/libnsbmp.h"
+#include "include/colorflow.h"
+
+
+static void displayDebugInfo(char* debugInfo){
+  printf("%s\n", debugInfo);
+}
+
+/// @brief time of a monotonic clock, only read when the context has a profile
+/// @return time in nanoseconds
+static int64_t profileClock(void){
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (int64_t)time.tv_sec*1000000000 + time.tv_nsec;
+}
+
+/// @brief start timing the stages of a picture, nothing when the context has no profile
+/// @param ctx context of the computation
+static inline void profileStart(colorflow_ctx *ctx){
+  if(__builtin_expect(ctx->profile != NULL, 0)){
+    ctx->profile_lap = profileClock();
+    if(ctx->profile->start == 0){
+      ctx->profile->start = ctx->profile_lap;
+    }
+  }
+}
+
+/// @brief add the time elapsed since the previous lap and some bytes to a stage, the next stage starts now
+/// @param ctx context of the computation, nothing is done when it has no profile
+/// @param stage one of the COLORFLOW_STAGE values
+/// @param bytes number of bytes read or produced by the stage
+static inline void profileLap(colorflow_ctx *ctx, int stage, size_t bytes){
+  if(__builtin_expect(ctx->profile != NULL, 0)){
+    int64_t now = profileClock();
+    ctx->profile->nanoseconds[stage] += now - ctx->profile_lap;
+    ctx->profile->bytes[stage] += bytes;
+    ctx->profile->end[stage] = now;
+    ctx->profile_lap = now;
+  }
+}
+
+// Error manager that gives the control back to the reading function instead of exiting
+typedef struct{
+  struct jpeg_error_mgr pub;
+  jmp_buf setjmp_buffer;
+} jpeg_error_handler;
+
+static void jpeg_error_exit(j_common_ptr cinfo){
+  jpeg_error_handler *handler = (jpeg_error_handler*)cinfo->err;
+  (*cinfo->err->output_message)(cinfo);
+  longjmp(handler->setjmp_buffer, 1);
+}
+
+// Decoder structures a context keeps from one picture to the next
+typedef struct{
+  struct jpeg_decompress_struct cinfo;
+  jpeg_error_handler jerr;
+} colorflow_decoders;
+
+/// @brief create a context, its buffers are allowed by the first pictures
+/// @return new context, NULL if the memory could not be allowed
+colorflow_ctx *colorflow_ctx_create(void){
+  colorflow_ctx *ctx = (colorflow_ctx*)calloc(1, sizeof(colorflow_ctx));
+  return ctx;
+}
+
+/// @brief free a context and its buffers
+/// @param ctx context created by colorflow_ctx_create
+void colorflow_ctx_destroy(colorflow_ctx *ctx){
+  if(!ctx){
+    return;
+  }
+  if(ctx->decoders){
+    colorflow_decoders *decoders = (colorflow_decoders*)ctx->decoders;
+    jpeg_destroy_decompress(&decoders->cinfo);
+    free(decoders);
+  }
+  free(ctx->row);
+  free(ctx->pixels);
+  free(ctx->table_sums);
+  free(ctx->zone_sums);
+  free(ctx);
+}
+
+/// @brief create the decoder structures of a context the first time they are needed
+/// @param ctx context of the computation
+/// @return decoder structures of the context, NULL if the memory could not be allowed
+static colorflow_decoders *getDecoders(colorflow_ctx *ctx){
+  if(!ctx->decoders){
+    colorflow_decoders *decoders = (colorflow_decoders*)malloc(sizeof(colorflow_decoders));
+    if(!decoders){
+      return NULL;
+    }
+    decoders->cinfo.err = jpeg_std_error(&decoders->jerr.pub);
+    decoders->jerr.pub.error_exit = jpeg_error_exit;
+    if(setjmp(decoders->jerr.setjmp_buffer)){
+      free(decoders);
+      return NULL;
+    }
+    jpeg_create_decompress(&decoders->cinfo);
+    ctx->decoders = decoders;
+  }
+  return (colorflow_decoders*)ctx->decoders;
+}
+
+// The rows of pixels start on cache lines, which are also the widest SIMD registers
+#define PIXELS_ALIGNMENT 64
+
+/// @brief allow a buffer of pixels aligned on PIXELS_ALIGNMENT bytes
+/// @param size number of bytes of the buffer
+/// @return the buffer, to free with free, NULL if the memory could not be allowed
+static pixel *allocateAligned(size_t size){
+  void *buffer;
+  if(posix_memalign(&buffer, PIXELS_ALIGNMENT, size ? size : 1) != 0){
+    return NULL;
+  }
+  return (pixel*)buffer;
+}
+
+/// @brief make sure the row buffer of the context can store a row of the current picture
+/// @param ctx context whose width is set
+/// @return COLORFLOW_OK or COLORFLOW_ERROR_MALLOC
+static int allocateRow(colorflow_ctx *ctx){
+  if((size_t)ctx->width > ctx->row_capacity){
+    free(ctx->row);
+    ctx->row = allocateAligned(ctx->width*sizeof(pixel));
+    if(!ctx->row){
+      ctx->row_capacity = 0;
+      return COLORFLOW_ERROR_MALLOC;
+    }
+    ctx->row_capacity = ctx->width;
+  }
+  return COLORFLOW_OK;
+}
+
+/// @brief make sure the matrix of pixels of the context can store the current picture, each row starting on PIXELS_ALIGNMENT bytes
+/// @param ctx context whose width and height are set
+/// @return COLORFLOW_OK, COLORFLOW_ERROR_MEMORY_BUDGET or COLORFLOW_ERROR_MALLOC
+static int allocatePixels(colorflow_ctx *ctx){
+  size_t row_alignment = PIXELS_ALIGNMENT/sizeof(pixel);
+  ctx->stride = ((size_t)ctx->width + row_alignment - 1)/row_alignment*row_alignment;
+  size_t needed = (size_t)ctx->height*ctx->stride*sizeof(pixel);
+  if(ctx->options.memory_budget && needed > ctx->options.memory_budget){
+    return COLORFLOW_ERROR_MEMORY_BUDGET;
+  }
+  if(needed > ctx->pixels_capacity){
+    free(ctx->pixels);
+    ctx->pixels = allocateAligned(needed);
+    if(!ctx->pixels){
+      ctx->pixels_capacity = 0;
+      return COLORFLOW_ERROR_MALLOC;
+    }
+    ctx->pixels_capacity = needed;
+  }
+  return COLORFLOW_OK;
+}
+
+/// @brief row of the matrix of pixels of the context
+/// @param ctx context whose matrix of pixels is allowed
+/// @param y index of the row
+/// @return first pixel of the row
+static pixel *pixelRow(colorflow_ctx *ctx, int y){
+  return ctx->pixels + (size_t)y*ctx->stride;
+}
+
+/// @param r Red component
+/// @param g Green component
+/// @param b Blue component
+/// @param a Alpha component
+/// @return new created pixel with the specified RGBA values
+pixel createPixel(unsigned char r, unsigned char g, unsigned char b, unsigned char a){
+  pixel p;
+  p.red = r;
+  p.green = g;
+  p.blue = b;
+  p.alpha = a;
+  return p;
+}
+
+/// @brief set the bounds of the four borders of a picture
+/// @param accumulator border accumulator whose bounds are set
+/// @param width width of the picture
+/// @param height height of the picture
+/// @param frame_percentage percentage of the border
+static void setBorderBounds(border_accumulator *accumulator, int width, int height, float frame_percentage){
+  accumulator->width = width;
+  accumulator->height = height;
+
+  // Same bounds as the ones used by getAverageColor
+  accumulator->up_end = (int)(height*frame_percentage);
+  accumulator->right_start = (int)(width*(1-frame_percentage));
+  accumulator->down_start = (int)((1-frame_percentage)*height);
+  accumulator->left_end = (int)(width*frame_percentage);
+  // Every pixel is summed unless initBorderAccumulator samples the borders
+  accumulator->stride = 1;
+}
+
+// Borders in the order of the samples and squares of a border accumulator
+#define BORDER_UP 0
+#define BORDER_RIGHT 1
+#define BORDER_DOWN 2
+#define BORDER_LEFT 3
+
+/// @brief sums of a border of an accumulator
+/// @param accumulator border accumulator
+/// @param border BORDER_UP, BORDER_RIGHT, BORDER_DOWN or BORDER_LEFT
+/// @return RGBA sums of the border
+static int64_t *borderSums(border_accumulator *accumulator, int border){
+  switch(border){
+    case BORDER_UP:
+      return accumulator->up;
+    case BORDER_RIGHT:
+      return accumulator->right;
+    case BORDER_DOWN:
+      return accumulator->down;
+    default:
+      return accumulator->left;
+  }
+}
+
+/// @brief choose the stride the borders are sampled with, from the options of the computation
+/// @param ctx context of the computation
+/// @param accumulator border accumulator whose bounds are set
+/// @return number of rows and of columns from one sample to the next, 1 to sum every pixel
+static int sampleStride(colorflow_ctx *ctx, border_accumulator *accumulator){
+  // Frame tables and zones sum every pixel
+  if(ctx->table || ctx->zones){
+    return 1;
+  }
+  int width = accumulator->width;
+  int height = accumulator->height;
+  int stride = ctx->options.sample_stride;
+
+  // Sampling one row and one column in stride divides the number of pixels summed by stride squared
+  if(ctx->options.sample_budget > 0){
+    int64_t inner_width = accumulator->right_start > accumulator->left_end ? accumulator->right_start - accumulator->left_end : 0;
+    int64_t inner_height = accumulator->down_start > accumulator->up_end ? accumulator->down_start - accumulator->up_end : 0;
+    int64_t frame = (int64_t)width*height - inner_width*inner_height;
+    stride = 1;
+    while((frame + (int64_t)stride*stride - 1)/((int64_t)stride*stride) > (int64_t)ctx->options.sample_budget){
+      stride++;
+    }
+  }
+
+  // The rows and columns sampled are the multiples of the stride, every border keeps at least one of them
+  int thinnest = accumulator->up_end;
+  if(width - accumulator->right_start < thinnest){
+    thinnest = width - accumulator->right_start;
+  }
+  if(height - accumulator->down_start < thinnest){
+    thinnest = height - accumulator->down_start;
+  }
+  if(accumulator->left_end < thinnest){
+    thinnest = accumulator->left_end;
+  }
+  if(stride > thinnest){
+    stride = thinnest;
+  }
+  return stride > 1 ? stride : 1;
+}
+
+/// @brief set up the bounds of the four borders of the picture and reset their sums
+/// @param ctx context that holds the dimensions of the picture
+/// @param accumulator border accumulator to initialize
+/// @param frame_percentage percentage of the border to calculate the average RGBA
+void initBorderAccumulator(colorflow_ctx *ctx, border_accumulator *accumulator, float frame_percentage){
+
+  if(ctx->options.debug_mode){
+    char debugInfo[150];
+    sprintf(debugInfo, "void initBorderAccumulator(colorflow_ctx *ctx, border_accumulator *accumulator, float frame_percentage = %f)",frame_percentage);
+    displayDebugInfo(debugInfo);
+  }
+
+  setBorderBounds(accumulator, ctx->width, ctx->height, frame_percentage);
+
+  for(int i=0;i<4;i++){
+    accumulator->up[i] = 0;
+    accumulator->right[i] = 0;
+    accumulator->down[i] = 0;
+    accumulator->left[i] = 0;
+    accumulator->samples[i] = 0;
+    ctx->standard_error[i] = 0;
+  }
+  memset(accumulator->squares, 0, sizeof(accumulator->squares));
+  accumulator->stride = sampleStride(ctx, accumulator);
+  accumulator->table = NULL;
+  accumulator->zones = NULL;
+}
+
+/// @brief first row at or after a row that is summed, with a stride the rows in between do not need to be decoded
+/// @param accumulator border accumulator initialized by initBorderAccumulator
+/// @param y index of a row in the picture
+/// @return index of the next row summed, the height of the picture or more when there is none
+static int nextSampledRow(border_accumulator *accumulator, int y){
+  int stride = accumulator->stride;
+  return (y + stride - 1)/stride*stride;
+}
+
+/// @brief add the sampled pixels of a span of a row to a border, the columns that are multiples of the stride
+/// @param accumulator border accumulator with a stride
+/// @param border BORDER_UP, BORDER_RIGHT, BORDER_DOWN or BORDER_LEFT
+/// @param row row of pixels, row[0] being the pixel of column row_start
+/// @param row_start column of the first pixel of row
+/// @param start_column specifies on which column the span starts
+/// @param end_column specifies on which column the span ends
+static void sampleSpan(border_accumulator *accumulator, int border, pixel *row, int row_start, int start_column, int end_column){
+  int stride = accumulator->stride;
+  int64_t *sums = borderSums(accumulator, border);
+  int64_t *squares = accumulator->squares + 4*border;
+  for(int x = (start_column + stride - 1)/stride*stride; x < end_column; x += stride){
+    pixel p = row[x - row_start];
+    int values[4] = {p.red, p.green, p.blue, p.alpha};
+    for(int i=0;i<4;i++){
+      sums[i] += values[i];
+      squares[i] += values[i]*values[i];
+    }
+    accumulator->samples[border]++;
+  }
+}
+
+/// @brief add the sampled pixels of a row to every border it belongs to, only the rows that are multiples of the stride are sampled
+/// @param accumulator border accumulator with a stride
+/// @param y index of the row in the picture
+/// @param row row of pixels
+static void sampleRow(border_accumulator *accumulator, int y, pixel *row){
+  if(y % accumulator->stride){
+    return;
+  }
+  int width = accumulator->width;
+  if(y < accumulator->up_end){
+    sampleSpan(accumulator, BORDER_UP, row, 0, 0, width);
+  }
+  if(y >= accumulator->down_start){
+    sampleSpan(accumulator, BORDER_DOWN, row, 0, 0, width);
+  }
+  sampleSpan(accumulator, BORDER_RIGHT, row, 0, accumulator->right_start, width);
+  sampleSpan(accumulator, BORDER_LEFT, row, 0, 0, accumulator->left_end);
+}
+
+/// @brief add a row of the picture to the row and column sums of a frame table
+/// @param table frame table initialized by initFrameTable
+/// @param y index of the row in the picture
+/// @param row row of pixels
+static void addRowToTable(frame_table *table, int y, pixel *row){
+  int width = table->width;
+  int height = table->height;
+
+  // Whole rows of the upper and lower borders, a row can belong to both
+  if(y < table->up_end || y >= table->down_start){
+    int64_t sums[4] = {0,0,0,0};
+    sumRow(sums, row, 0, width);
+    for(int i=0;i<4;i++){
+      if(y < table->up_end){
+        table->up[4*(y+1)+i] += sums[i];
+      }
+      if(y >= table->down_start){
+        table->down[4*(height-y)+i] += sums[i];
+      }
+    }
+  }
+
+  // Columns of the left and right borders, on every row
+  for(int x=0; x<table->left_end; x++){
+    int64_t *sums = table->left + 4*(x+1);
+    sums[0] += row[x].red;
+    sums[1] += row[x].green;
+    sums[2] += row[x].blue;
+    sums[3] += row[x].alpha;
+  }
+  for(int x=table->right_start; x<width; x++){
+    int64_t *sums = table->right + 4*(width-x);
+    sums[0] += row[x].red;
+    sums[1] += row[x].green;
+    sums[2] += row[x].blue;
+    sums[3] += row[x].alpha;
+  }
+}
+
+/// @brief first row or column of a zone, the zones of a border differ by at most one row or column
+/// @param zone index of the zone, amount gives the end of the last zone
+/// @param amount number of zones of the border
+/// @param length number of rows or columns of the border
+/// @return index of the first row or column of the zone
+static int zoneStart(int zone, int amount, int length){
+  return (int)(((int64_t)zone*length + amount - 1)/amount);
+}
+
+/// @brief add a row of the picture to every zone it belongs to
+/// @param zones zone accumulator initialized by initZoneAccumulator
+/// @param y index of the row in the picture
+/// @param row row of pixels
+static void addRowToZones(zone_accumulator *zones, int y, pixel *row){
+  int width = zones->width;
+  if(y < zones->up_end){
+    for(int i=0; i<zones->top_amount; i++){
+      sumRow(zones->up + 4*i, row, zoneStart(i, zones->top_amount, width), zoneStart(i+1, zones->top_amount, width));
+    }
+  }
+  if(y >= zones->down_start){
+    for(int i=0; i<zones->top_amount; i++){
+      sumRow(zones->down + 4*i, row, zoneStart(i, zones->top_amount, width), zoneStart(i+1, zones->top_amount, width));
+    }
+  }
+
+  // The row belongs to a single zone of each side
+  int zone = (int)((int64_t)y*zones->side_amount/zones->height);
+  sumRow(zones->left + 4*zone, row, 0, zones->left_end);
+  sumRow(zones->right + 4*zone, row, zones->right_start, width);
+}
+
+/// @brief add a row of the picture to every border it belongs to
+/// @param accumulator border accumulator initialized by initBorderAccumulator
+/// @param y index of the row in the picture
+/// @param row row of pixels
+void accumulateRow(border_accumulator *accumulator, int y, pixel *row){
+  if(accumulator->table){
+    addRowToTable(accumulator->table, y, row);
+    return;
+  }
+  if(accumulator->zones){
+    addRowToZones(accumulator->zones, y, row);
+    return;
+  }
+  if(accumulator->stride > 1){
+    sampleRow(accumulator, y, row);
+    return;
+  }
+  int width = accumulator->width;
+  int left_end = accumulator->left_end;
+  int right_start = accumulator->right_start;
+  int in_up = y < accumulator->up_end;
+  int in_down = y >= accumulator->down_start;
+
+  // A row of the upper or lower border is read once: its left span, middle and right span are summed apart,
+  // the spans go to the left and right borders and the three of them to the upper and lower borders,
+  // so the corners keep counting in both of their borders
+  if((in_up || in_down) && left_end <= right_start){
+    int64_t left[4] = {0,0,0,0}, middle[4] = {0,0,0,0}, right[4] = {0,0,0,0};
+    sumRow(left, row, 0, left_end);
+    sumRow(middle, row, left_end, right_start);
+    sumRow(right, row, right_start, width);
+    for(int i=0;i<4;i++){
+      int64_t full = left[i] + middle[i] + right[i];
+      if(in_up){
+        accumulator->up[i] += full;
+      }
+      if(in_down){
+        accumulator->down[i] += full;
+      }
+      accumulator->left[i] += left[i];
+      accumulator->right[i] += right[i];
+    }
+    return;
+  }
+
+  // Overlapping left and right borders, only with a frame wider than half the picture
+  if(in_up){
+    sumRow(accumulator->up, row, 0, width);
+  }
+  if(in_down){
+    sumRow(accumulator->down, row, 0, width);
+  }
+  sumRow(accumulator->right, row, right_start, width);
+  sumRow(accumulator->left, row, 0, left_end);
+}
+
+/// @brief divide the sum of each border by its number of pixels and average the four borders
+/// @param sums array that contains the RGBA sums of a border, replaced by its average
+/// @param pixel_amount number of pixels of the border
+static void divideBorderSums(int64_t *sums, int64_t pixel_amount){
+
+  // Measure to avoid division by 0
+  if(pixel_amount == 0){
+    pixel_amount = 1;
+  }
+
+  for(int i=0;i<4;i++){
+    sums[i] /= pixel_amount;
+  }
+}
+
+/// @brief determine the RGBA average color of a sampled frame, and the standard error of each of its components
+/// @param ctx context we want to store the standard errors into
+/// @param accumulator border accumulator filled by accumulateRow with a stride
+/// @param average_RGBA array we want to store the average RGBA color into
+static void computeSampledColor(colorflow_ctx *ctx, border_accumulator *accumulator, int *average_RGBA){
+  int width = accumulator->width;
+  int height = accumulator->height;
+  // Pixels of each border, which its samples are drawn from
+  int64_t populations[4] = {(int64_t)accumulator->up_end*width, (int64_t)height*(width-accumulator->right_start), (int64_t)(height-accumulator->down_start)*width, (int64_t)height*accumulator->left_end};
+  int64_t averages[4] = {0,0,0,0};
+  double variances[4] = {0,0,0,0};
+
+  for(int border=0; border<4; border++){
+    int64_t *sums = borderSums(accumulator, border);
+    int64_t amount = accumulator->samples[border];
+    if(amount == 0){
+      continue;
+    }
+    for(int i=0;i<4;i++){
+      averages[i] += sums[i]/amount;
+      if(amount > 1){
+        // Variance of the mean of the border, the samples being a part of its pixels
+        double mean = (double)sums[i]/amount;
+        double variance = ((double)accumulator->squares[4*border+i] - amount*mean*mean)/(amount-1);
+        variances[i] += variance/amount*(1 - (double)amount/populations[border]);
+      }
+    }
+  }
+
+  // The average of the four borders has the sum of their variances divided by 16
+  for(int i=0;i<4;i++){
+    average_RGBA[i] = (int)(averages[i]/4);
+    ctx->standard_error[i] = variances[i] > 0 ? (float)(sqrt(variances[i])/4) : 0;
+  }
+}
+
+/// @brief determine the RGBA average color of the frame once every row has been accumulated
+/// @param ctx context of the computation
+/// @param accumulator border accumulator filled by accumulateRow
+/// @param average_RGBA array we want to store the average RGBA color into
+void computeAverageColor(colorflow_ctx *ctx, border_accumulator *accumulator, int *average_RGBA){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("void computeAverageColor(colorflow_ctx *ctx, border_accumulator *accumulator, int *average_RGBA)");
+  }
+
+  if(accumulator->stride > 1){
+    computeSampledColor(ctx, accumulator, average_RGBA);
+    return;
+  }
+
+  int width = accumulator->width;
+  int height = accumulator->height;
+  divideBorderSums(accumulator->up, (int64_t)accumulator->up_end*width);
+  divideBorderSums(accumulator->right, (int64_t)height*(width-accumulator->right_start));
+  divideBorderSums(accumulator->down, (int64_t)(height-accumulator->down_start)*width);
+  divideBorderSums(accumulator->left, (int64_t)height*accumulator->left_end);
+
+  for(int i=0;i<4;i++){
+    average_RGBA[i] = (int)((accumulator->up[i]+accumulator->right[i]+accumulator->down[i]+accumulator->left[i])/4);
+  }
+}
+
+/// @brief set up a frame table on the bounds of a border accumulator, the rows given to the accumulator are then added to the table
+/// @param ctx context that keeps the sums of the table
+/// @param table frame table to initialize
+/// @param accumulator border accumulator initialized by initBorderAccumulator with the widest frame percentage
+/// @return COLORFLOW_OK or COLORFLOW_ERROR_MALLOC
+int initFrameTable(colorflow_ctx *ctx, frame_table *table, border_accumulator *accumulator){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("int initFrameTable(colorflow_ctx *ctx, frame_table *table, border_accumulator *accumulator)");
+  }
+
+  int width = accumulator->width;
+  int height = accumulator->height;
+  table->width = width;
+  table->height = height;
+  table->up_end = accumulator->up_end;
+  table->right_start = accumulator->right_start;
+  table->down_start = accumulator->down_start;
+  table->left_end = accumulator->left_end;
+
+  // Index 0 of each prefix holds the sums of an empty border
+  size_t up_amount = table->up_end + 1;
+  size_t right_amount = width - table->right_start + 1;
+  size_t down_amount = height - table->down_start + 1;
+  size_t left_amount = table->left_end + 1;
+  size_t needed = 4*(up_amount + right_amount + down_amount + left_amount);
+  if(needed > ctx->table_capacity){
+    free(ctx->table_sums);
+    ctx->table_sums = (int64_t*)malloc(needed*sizeof(int64_t));
+    if(!ctx->table_sums){
+      ctx->table_capacity = 0;
+      return COLORFLOW_ERROR_MALLOC;
+    }
+    ctx->table_capacity = needed;
+  }
+  memset(ctx->table_sums, 0, needed*sizeof(int64_t));
+
+  table->up = ctx->table_sums;
+  table->right = table->up + 4*up_amount;
+  table->down = table->right + 4*right_amount;
+  table->left = table->down + 4*down_amount;
+
+  accumulator->table = table;
+  return COLORFLOW_OK;
+}
+
+/// @brief turn the sums of every row and column of a frame table into prefix sums
+/// @param sums sums of a border, 4 per row or column, starting with the empty border
+/// @param amount number of rows or columns of the border
+static void prefixSums(int64_t *sums, int amount){
+  for(int k=1; k<=amount; k++){
+    for(int i=0;i<4;i++){
+      sums[4*k+i] += sums[4*(k-1)+i];
+    }
+  }
+}
+
+/// @brief finish a frame table once every row has been accumulated
+/// @param table frame table filled by accumulateRow
+void finishFrameTable(frame_table *table){
+  prefixSums(table->up, table->up_end);
+  prefixSums(table->right, table->width - table->right_start);
+  prefixSums(table->down, table->height - table->down_start);
+  prefixSums(table->left, table->left_end);
+}
+
+/// @brief determine the RGBA average color of a frame from a frame table, in constant time
+/// @param ctx context of the computation
+/// @param table frame table finished by finishFrameTable
+/// @param frame_percentage percentage of the border, at most the one the table was built with
+/// @param average_RGBA array we want to store the average RGBA color into
+void readFrameTable(colorflow_ctx *ctx, frame_table *table, float frame_percentage, int *average_RGBA){
+
+  if(ctx->options.debug_mode){
+    char debugInfo[150];
+    sprintf(debugInfo, "void readFrameTable(colorflow_ctx *ctx, frame_table *table, float frame_percentage = %f, int *average_RGBA)",frame_percentage);
+    displayDebugInfo(debugInfo);
+  }
+
+  // The bounds are the ones of a single percentage, so are the averages
+  // The table has the dimensions of the decoded picture, smaller than the one of the file for scaled JPEG pictures
+  border_accumulator accumulator;
+  setBorderBounds(&accumulator, table->width, table->height, frame_percentage);
+  assert(accumulator.up_end <= table->up_end && accumulator.left_end <= table->left_end);
+
+  for(int i=0;i<4;i++){
+    accumulator.up[i] = table->up[4*accumulator.up_end+i];
+    accumulator.right[i] = table->right[4*(table->width-accumulator.right_start)+i];
+    accumulator.down[i] = table->down[4*(table->height-accumulator.down_start)+i];
+    accumulator.left[i] = table->left[4*accumulator.left_end+i];
+  }
+  computeAverageColor(ctx, &accumulator, average_RGBA);
+}
+
+/// @brief set up a zone accumulator on the bounds of a border accumulator, the rows given to the accumulator are then added to the zones
+/// @param ctx context that keeps the sums of the zones
+/// @param zones zone accumulator to initialize
+/// @param accumulator border accumulator initialized by initBorderAccumulator
+/// @param top_amount number of zones of the upper and lower borders
+/// @param side_amount number of zones of the left and right borders
+/// @return COLORFLOW_OK, COLORFLOW_ERROR_BAD_ZONES or COLORFLOW_ERROR_MALLOC
+int initZoneAccumulator(colorflow_ctx *ctx, zone_accumulator *zones, border_accumulator *accumulator, int top_amount, int side_amount){
+
+  if(ctx->options.debug_mode){
+    char debugInfo[200];
+    sprintf(debugInfo, "int initZoneAccumulator(colorflow_ctx *ctx, zone_accumulator *zones, border_accumulator *accumulator, int top_amount = %d, int side_amount = %d)",top_amount,side_amount);
+    displayDebugInfo(debugInfo);
+  }
+
+  if(top_amount <= 0 || side_amount <= 0){
+    return COLORFLOW_ERROR_BAD_ZONES;
+  }
+
+  zones->top_amount = top_amount;
+  zones->side_amount = side_amount;
+  zones->width = accumulator->width;
+  zones->height = accumulator->height;
+  zones->up_end = accumulator->up_end;
+  zones->right_start = accumulator->right_start;
+  zones->down_start = accumulator->down_start;
+  zones->left_end = accumulator->left_end;
+
+  size_t needed = 8*((size_t)top_amount + side_amount);
+  if(needed > ctx->zone_capacity){
+    free(ctx->zone_sums);
+    ctx->zone_sums = (int64_t*)malloc(needed*sizeof(int64_t));
+    if(!ctx->zone_sums){
+      ctx->zone_capacity = 0;
+      return COLORFLOW_ERROR_MALLOC;
+    }
+    ctx->zone_capacity = needed;
+  }
+  memset(ctx->zone_sums, 0, needed*sizeof(int64_t));
+
+  zones->up = ctx->zone_sums;
+  zones->right = zones->up + 4*top_amount;
+  zones->down = zones->right + 4*side_amount;
+  zones->left = zones->down + 4*top_amount;
+
+  accumulator->zones = zones;
+  return COLORFLOW_OK;
+}
+
+/// @brief divide the sums of a zone by its number of pixels
+/// @param sums array that contains the RGBA sums of the zone
+/// @param pixel_amount number of pixels of the zone
+/// @param color array we want to store the RGBA average color of the zone into
+static void getZoneColor(int64_t *sums, int64_t pixel_amount, int *color){
+  int64_t average[4] = {sums[0], sums[1], sums[2], sums[3]};
+  divideBorderSums(average, pixel_amount);
+  for(int i=0;i<4;i++){
+    color[i] = (int)average[i];
+  }
+}
+
+/// @brief determine the RGBA average color of every zone once every row has been accumulated
+/// @param ctx context of the computation
+/// @param zones zone accumulator filled by accumulateRow
+/// @param zone_RGBA array of 4 values per zone, filled clockwise from the top left corner
+void computeZoneColors(colorflow_ctx *ctx, zone_accumulator *zones, int *zone_RGBA){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("void computeZoneColors(colorflow_ctx *ctx, zone_accumulator *zones, int *zone_RGBA)");
+  }
+
+  int width = zones->width;
+  int height = zones->height;
+  int top_amount = zones->top_amount;
+  int side_amount = zones->side_amount;
+  int *color = zone_RGBA;
+
+  // Upper border from left to right
+  for(int i=0; i<top_amount; i++, color+=4){
+    int columns = zoneStart(i+1, top_amount, width) - zoneStart(i, top_amount, width);
+    getZoneColor(zones->up + 4*i, (int64_t)zones->up_end*columns, color);
+  }
+  // Right border from top to bottom
+  for(int i=0; i<side_amount; i++, color+=4){
+    int rows = zoneStart(i+1, side_amount, height) - zoneStart(i, side_amount, height);
+    getZoneColor(zones->right + 4*i, (int64_t)rows*(width-zones->right_start), color);
+  }
+  // Lower border from right to left
+  for(int i=top_amount-1; i>=0; i--, color+=4){
+    int columns = zoneStart(i+1, top_amount, width) - zoneStart(i, top_amount, width);
+    getZoneColor(zones->down + 4*i, (int64_t)(height-zones->down_start)*columns, color);
+  }
+  // Left border from bottom to top
+  for(int i=side_amount-1; i>=0; i--, color+=4){
+    int rows = zoneStart(i+1, side_amount, height) - zoneStart(i, side_amount, height);
+    getZoneColor(zones->left + 4*i, (int64_t)rows*zones->left_end, color);
+  }
+}
+
+/// @brief set up the border accumulator of the current picture, and the frame table of the context when there is one
+/// @param ctx context of the computation
+/// @param accumulator border accumulator to initialize
+/// @return COLORFLOW_OK or COLORFLOW_ERROR_MALLOC
+static int startFrame(colorflow_ctx *ctx, border_accumulator *accumulator){
+  initBorderAccumulator(ctx, accumulator, ctx->options.frame_percentage);
+  if(ctx->table){
+    return initFrameTable(ctx, ctx->table, accumulator);
+  }
+  if(ctx->zones){
+    return initZoneAccumulator(ctx, ctx->zones, accumulator, ctx->zones->top_amount, ctx->zones->side_amount);
+  }
+  return COLORFLOW_OK;
+}
+
+/// @brief determine the RGBA average color of the frame, or finish the frame table of the context
+/// @param ctx context of the computation
+/// @param accumulator border accumulator filled by accumulateRow
+/// @param average_RGBA array we want to store the average RGBA color into
+static void finishFrame(colorflow_ctx *ctx, border_accumulator *accumulator, int *average_RGBA){
+  if(accumulator->table){
+    finishFrameTable(accumulator->table);
+    profileLap(ctx, COLORFLOW_STAGE_ACCUMULATE, 0);
+    return;
+  }
+
+  // The sums of a border are the sums of its zones
+  zone_accumulator *zones = accumulator->zones;
+  if(zones){
+    for(int i=0;i<4;i++){
+      for(int k=0; k<zones->top_amount; k++){
+        accumulator->up[i] += zones->up[4*k+i];
+        accumulator->down[i] += zones->down[4*k+i];
+      }
+      for(int k=0; k<zones->side_amount; k++){
+        accumulator->right[i] += zones->right[4*k+i];
+        accumulator->left[i] += zones->left[4*k+i];
+      }
+    }
+  }
+  computeAverageColor(ctx, accumulator, average_RGBA);
+  profileLap(ctx, COLORFLOW_STAGE_ACCUMULATE, 0);
+}
+
+/// @brief read function of libpng for a picture stored in memory
+/// @param png png structure whose io pointer is the context
+/// @param out buffer of libpng we want to copy the next bytes of the picture into
+/// @param length number of bytes
+static void read_png_memory(png_structp png, png_bytep out, png_size_t length){
+  colorflow_ctx *ctx = (colorflow_ctx*)png_get_io_ptr(png);
+  if(length > ctx->size - ctx->data_offset){
+    png_error(png, "Read Error");
+  }
+  memcpy(out, ctx->data + ctx->data_offset, length);
+  ctx->data_offset += length;
+}
+
+/// @brief set up a png structure to read 8bit RGBA rows and read the header of the file
+/// @param ctx context we want to store the dimensions of the picture into
+/// @param png png structure whose error handler is set by the caller
+/// @param info info structure of the png file
+/// @param file binary file of a png picture, NULL for a picture stored in memory
+/// @author code from https://gist.github.com/niw/5963798
+static void open_png_file(colorflow_ctx *ctx, png_structp png, png_infop info, FILE *file){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static void open_png_file(colorflow_ctx *ctx, png_structp png, png_infop info, FILE *file)");
+  }
+
+  png_byte color_type;
+  png_byte bit_depth;
+
+  if(ctx->data){
+    ctx->data_offset = 0;
+    png_set_read_fn(png, ctx, read_png_memory);
+  }
+  else{
+    png_init_io(png, file);
+  }
+
+  png_read_info(png, info);
+
+  ctx->width  = png_get_image_width(png, info);
+  ctx->height = png_get_image_height(png, info);
+  color_type  = png_get_color_type(png, info);
+  bit_depth   = png_get_bit_depth(png, info);
+
+  // Read any color_type into 8bit depth, RGBA format.
+  // See http://www.libpng.org/pub/png/libpng-manual.txt
+
+  if(bit_depth == 16)
+    png_set_strip_16(png);
+
+  if(color_type == PNG_COLOR_TYPE_PALETTE)
+    png_set_palette_to_rgb(png);
+
+  // PNG_COLOR_TYPE_GRAY_ALPHA is always 8 or 16bit depth.
+  if(color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
+    png_set_expand_gray_1_2_4_to_8(png);
+
+  if(png_get_valid(png, info, PNG_INFO_tRNS))
+    png_set_tRNS_to_alpha(png);
+
+  // These color_type don't have an alpha channel then fill it with 0xff.
+  if(color_type == PNG_COLOR_TYPE_RGB ||
+     color_type == PNG_COLOR_TYPE_GRAY ||
+     color_type == PNG_COLOR_TYPE_PALETTE)
+    png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+
+  if(color_type == PNG_COLOR_TYPE_GRAY ||
+     color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+    png_set_gray_to_rgb(png);
+
+  png_set_interlace_handling(png);
+
+  png_read_update_info(png, info);
+  profileLap(ctx, COLORFLOW_STAGE_HEADER, 0);
+}
+
+/// @brief read all the rows of an opened png file into the matrix of pixels of the context
+/// @param ctx context of the computation
+/// @param png png structure set up by open_png_file
+/// @return COLORFLOW_OK or an error code
+static int read_png_pixels(colorflow_ctx *ctx, png_structp png){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int read_png_pixels(colorflow_ctx *ctx, png_structp png)");
+  }
+
+  int code = allocatePixels(ctx);
+  if(code != COLORFLOW_OK){
+    return code;
+  }
+
+  // Rows are transformed into 8bit RGBA, which is the layout of a row of pixels
+  // The interlace handling set by open_png_file gives the number of passes, each pass completes the rows of the previous ones
+  int passes = png_set_interlace_handling(png);
+  for(int pass = 0; pass < passes; pass++){
+    for(int y = 0; y < ctx->height; y++){
+      png_read_row(png, (png_bytep)pixelRow(ctx, y), NULL);
+    }
+  }
+  profileLap(ctx, COLORFLOW_STAGE_SCANLINES, (size_t)ctx->height*ctx->width*sizeof(pixel));
+
+  return COLORFLOW_OK;
+}
+
+/// @brief read a png file and store the RGBA values of each pixel in the matrix of pixels of the context
+/// @param ctx context of the computation
+/// @param file binary file of a png picture
+/// @return COLORFLOW_OK or an error code
+static int read_png_file(colorflow_ctx *ctx, FILE *file) {
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int read_png_file(colorflow_ctx *ctx, FILE *file)");
+  }
+
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if(!png) return COLORFLOW_ERROR_MALLOC;
+
+  png_infop info = png_create_info_struct(png);
+  if(!info){
+    png_destroy_read_struct(&png, NULL, NULL);
+    return COLORFLOW_ERROR_MALLOC;
+  }
+
+  if(setjmp(png_jmpbuf(png))){
+    png_destroy_read_struct(&png, &info, NULL);
+    return COLORFLOW_ERROR_BAD_FILE;
+  }
+
+  open_png_file(ctx, png, info, file);
+
+  int code = read_png_pixels(ctx, png);
+
+  // Free ressources
+  png_destroy_read_struct(&png, &info, NULL);
+  profileLap(ctx, COLORFLOW_STAGE_SCANLINES, 0);
+
+  return code;
+}
+
+/// @brief read a png file row by row and feed each row into border accumulators, without storing the whole picture
+/// @param ctx context of the computation
+/// @param file binary file of a png picture
+/// @param average_RGBA array we want to store the average RGBA color into
+/// @return COLORFLOW_OK or an error code
+static int read_png_frame_color(colorflow_ctx *ctx, FILE *file, int *average_RGBA){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int read_png_frame_color(colorflow_ctx *ctx, FILE *file, int *average_RGBA)");
+  }
+
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if(!png) return COLORFLOW_ERROR_MALLOC;
+
+  png_infop info = png_create_info_struct(png);
+  if(!info){
+    png_destroy_read_struct(&png, NULL, NULL);
+    return COLORFLOW_ERROR_MALLOC;
+  }
+
+  if(setjmp(png_jmpbuf(png))){
+    png_destroy_read_struct(&png, &info, NULL);
+    return COLORFLOW_ERROR_BAD_FILE;
+  }
+
+  open_png_file(ctx, png, info, file);
+
+  border_accumulator accumulator;
+  int code = startFrame(ctx, &accumulator);
+  int interlaced = png_get_interlace_type(png, info) != PNG_INTERLACE_NONE;
+
+  // Interlaced rows are only complete after the last pass, the whole picture is needed
+  if(code == COLORFLOW_OK && interlaced){
+    code = read_png_pixels(ctx, png);
+    if(code == COLORFLOW_OK){
+      for(int y = 0; y < ctx->height; y++){
+        accumulateRow(&accumulator, y, pixelRow(ctx, y));
+      }
+      profileLap(ctx, COLORFLOW_STAGE_ACCUMULATE, (size_t)ctx->height*ctx->width*sizeof(pixel));
+    }
+  }
+  else if(code == COLORFLOW_OK){
+    // Allow memory to be able to read 1 line of the picture
+    code = allocateRow(ctx);
+    if(code == COLORFLOW_OK){
+      size_t row_bytes = (size_t)ctx->width*sizeof(pixel);
+      for(int y = 0; y < ctx->height; y++){
+        png_read_row(png, (png_bytep)ctx->row, NULL);
+        profileLap(ctx, COLORFLOW_STAGE_SCANLINES, row_bytes);
+        accumulateRow(&accumulator, y, ctx->row);
+        profileLap(ctx, COLORFLOW_STAGE_ACCUMULATE, row_bytes);
+      }
+    }
+  }
+
+  // Free ressources
+  png_destroy_read_struct(&png, &info, NULL);
+  profileLap(ctx, COLORFLOW_STAGE_SCANLINES, 0);
+
+  if(code == COLORFLOW_OK){
+    finishFrame(ctx, &accumulator, average_RGBA);
+  }
+  return code;
+}
+
+/// @brief ask the library for RGBA scanlines, which have the layout of a row of pixels
+/// @param cinfo jpeg structure whose header has been read
+/// @return 1 when the scanlines are RGBA, 0 when the color space of the picture has no RGBA conversion and its scanlines are converted by read_jpg_row
+static int setJpegRGBAOutput(j_decompress_ptr cinfo){
+  J_COLOR_SPACE space = cinfo->jpeg_color_space;
+  if(space == JCS_GRAYSCALE || space == JCS_RGB || space == JCS_YCbCr){
+    cinfo->out_color_space = JCS_EXT_RGBA;
+    return 1;
+  }
+  return 0;
+}
+
+/// @brief convert a decoded jpeg scanline into a row of RGBA pixels
+/// @param scanline scanline returned by jpeg_read_scanlines
+/// @param numComponents number of components of each pixel of the scanline
+/// @param row row of pixels we want to store the RGBA values into
+/// @param row_width number of pixels of the scanline
+static void read_jpg_row(JSAMPROW scanline, int numComponents, pixel *row, int row_width){
+  for (int x = 0; x < row_width; x++) {
+    row[x] = createPixel(
+      scanline[x * numComponents],
+      scanline[x * numComponents + 1],
+      scanline[x * numComponents + 2],
+      (numComponents == 4) ? scanline[x * numComponents + 3] : 255);
+  }
+}
+
+/// @brief read the next scanline of a jpeg picture into a row of pixels
+/// @param ctx context of the computation
+/// @param cinfo jpeg structure whose output has started
+/// @param buffer scanline buffer for the color spaces converted by read_jpg_row, NULL when the library outputs RGBA
+/// @param row row of pixels we want to store the RGBA values into
+static void read_jpg_scanline(colorflow_ctx *ctx, j_decompress_ptr cinfo, JSAMPARRAY buffer, pixel *row){
+  if(!buffer){
+    JSAMPROW scanline = (JSAMPROW)row;
+    (void) jpeg_read_scanlines(cinfo, &scanline, 1);
+    profileLap(ctx, COLORFLOW_STAGE_SCANLINES, (size_t)cinfo->output_width*sizeof(pixel));
+    return;
+  }
+  (void) jpeg_read_scanlines(cinfo, buffer, 1);
+  profileLap(ctx, COLORFLOW_STAGE_SCANLINES, (size_t)cinfo->output_width*cinfo->output_components);
+  read_jpg_row(buffer[0], cinfo->output_components, row, cinfo->output_width);
+  profileLap(ctx, COLORFLOW_STAGE_REPACK, (size_t)cinfo->output_width*sizeof(pixel));
+}
+
+/// @brief read a jpeg file and store the RGBA values of each pixel in the matrix of pixels of the context
+/// @param ctx context of the computation
+/// @param file binary file of a jpeg picture
+/// @return COLORFLOW_OK or an error code
+/// @author code inspired by this code https://github.com/LuaDist/libjpeg/blob/master/example.c
+static int read_jpg_file(colorflow_ctx *ctx, FILE *file){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int read_jpg_file(colorflow_ctx *ctx, FILE *file)");
+  }
+
+  // Structure for JPEG picture, reused from one picture to the next
+  colorflow_decoders *decoders = getDecoders(ctx);
+  if(!decoders){
+    return COLORFLOW_ERROR_MALLOC;
+  }
+  j_decompress_ptr cinfo = &decoders->cinfo;
+  if(setjmp(decoders->jerr.setjmp_buffer)){
+    jpeg_abort_decompress(cinfo);
+    return COLORFLOW_ERROR_BAD_FILE;
+  }
+
+  // Link with JPEG file, or with the picture stored in memory
+  if(ctx->data){
+    jpeg_mem_src(cinfo, ctx->data, ctx->size);
+  }
+  else{
+    jpeg_stdio_src(cinfo, file);
+  }
+
+  // Reading headers
+  (void) jpeg_read_header(cinfo, TRUE);
+
+  // Grayscale, RGB and YCbCr pictures are converted to RGBA by the library
+  int rgba = setJpegRGBAOutput(cinfo);
+
+  // Start decompress
+  (void) jpeg_start_decompress(cinfo);
+  profileLap(ctx, COLORFLOW_STAGE_HEADER, 0);
+
+  // Reading pictures informations
+  ctx->width = cinfo->output_width;
+  ctx->height = cinfo->output_height;
+  int numComponents = cinfo->output_components;
+  int row_stride = ctx->width * numComponents;
+
+  // Allowing the memory for the matrix of pixels
+  int code = allocatePixels(ctx);
+  if(code != COLORFLOW_OK){
+    jpeg_abort_decompress(cinfo);
+    return code;
+  }
+
+  if(rgba){
+    // The scanlines are written straight into the rows of pixels
+    for(int y=0; y<ctx->height;y++){
+      JSAMPROW scanline = (JSAMPROW)pixelRow(ctx, y);
+      (void) jpeg_read_scanlines(cinfo, &scanline, 1);
+    }
+    profileLap(ctx, COLORFLOW_STAGE_SCANLINES, (size_t)ctx->height*ctx->width*sizeof(pixel));
+  }
+  else{
+    // Allow memory to be able to read 1 line of the picture
+    JSAMPARRAY buffer = (*cinfo->mem->alloc_sarray)((j_common_ptr) cinfo, JPOOL_IMAGE, row_stride, 1);
+    for(int y=0; y<ctx->height;y++){
+      (void) jpeg_read_scanlines(cinfo, buffer, 1);
+      profileLap(ctx, COLORFLOW_STAGE_SCANLINES, row_stride);
+      read_jpg_row(buffer[0], numComponents, pixelRow(ctx, y), ctx->width);
+      profileLap(ctx, COLORFLOW_STAGE_REPACK, (size_t)ctx->width*sizeof(pixel));
+    }
+  }
+
+  // Finish decompress
+  (void) jpeg_finish_decompress(cinfo);
+  profileLap(ctx, COLORFLOW_STAGE_SCANLINES, 0);
+
+
+  return COLORFLOW_OK;
+}
+
+/// @brief decode some rows of a buffered jpeg picture cropped to a span of columns and add this span to a border, the rows left out by the sampling are skipped
+/// @param ctx context of the computation
+/// @param cinfo jpeg structure in buffered image mode with the scans to output already consumed
+/// @param scan number of the last scan the output pass uses
+/// @param buffer scanline buffer as wide as the picture, NULL when the library outputs RGBA
+/// @param row row of pixels as wide as the picture
+/// @param width width of the picture
+/// @param accumulator border accumulator
+/// @param border BORDER_LEFT or BORDER_RIGHT, border the span is added to
+/// @param start_row specifies on which row the area starts
+/// @param end_row specifies on which row the area ends
+/// @param start_column specifies on which column the area starts
+/// @param end_column specifies on which column the area ends
+static void read_jpg_span(colorflow_ctx *ctx, j_decompress_ptr cinfo, int scan, JSAMPARRAY buffer, pixel *row, int width, border_accumulator *accumulator, int border, int start_row, int end_row, int start_column, int end_column){
+
+  if(start_row >= end_row || start_column >= end_column){
+    return;
+  }
+
+  (void) jpeg_start_output(cinfo, scan);
+
+  // A previous pass may have cropped output_width, the crop is requested against the whole width
+  cinfo->output_width = width;
+
+  // The crop is widened by the library to iMCU boundaries
+  JDIMENSION xoffset = start_column;
+  JDIMENSION crop_width = end_column - start_column;
+  jpeg_crop_scanline(cinfo, &xoffset, &crop_width);
+
+  (void) jpeg_skip_scanlines(cinfo, start_row);
+  while((int)cinfo->output_scanline < end_row){
+    int y = cinfo->output_scanline;
+    int next = nextSampledRow(accumulator, y);
+    if(next > y){
+      (void) jpeg_skip_scanlines(cinfo, (next < end_row ? next : end_row) - y);
+      continue;
+    }
+    read_jpg_scanline(ctx, cinfo, buffer, row);
+    if(accumulator->stride > 1){
+      sampleSpan(accumulator, border, row, xoffset, start_column, end_column);
+    }
+    else{
+      sumRow(borderSums(accumulator, border), row, start_column - xoffset, end_column - xoffset);
+    }
+    profileLap(ctx, COLORFLOW_STAGE_ACCUMULATE, (size_t)(end_column - start_column)*sizeof(pixel));
+  }
+
+  (void) jpeg_finish_output(cinfo);
+  profileLap(ctx, COLORFLOW_STAGE_SCANLINES, 0);
+}
+
+// The smallest side of a picture decoded with COLORFLOW_JPEG_SCALED keeps at least this many pixels
+#define JPEG_MIN_SCALED_SIZE 64
+
+/// @brief thinnest border of the frame of a picture
+/// @param width width of the picture
+/// @param height height of the picture
+/// @param frame_percentage percentage of the border
+/// @return number of rows or columns of the thinnest border
+static int thinnestBorder(int width, int height, float frame_percentage){
+  border_accumulator accumulator;
+  setBorderBounds(&accumulator, width, height, frame_percentage);
+  int thinnest = accumulator.up_end;
+  if(width - accumulator.right_start < thinnest){
+    thinnest = width - accumulator.right_start;
+  }
+  if(height - accumulator.down_start < thinnest){
+    thinnest = height - accumulator.down_start;
+  }
+  if(accumulator.left_end < thinnest){
+    thinnest = accumulator.left_end;
+  }
+  return thinnest;
+}
+
+/// @brief choose the scale a jpeg picture is decoded at for an approximation of its frame
+/// @param cinfo jpeg structure whose header has been read, its scale is set
+/// @param fast_jpeg COLORFLOW_JPEG_SCALED or COLORFLOW_JPEG_DC
+/// @param frame_percentage smallest percentage of the frame that is computed
+static void setJpegScale(j_decompress_ptr cinfo, int fast_jpeg, float frame_percentage){
+  int width = cinfo->image_width;
+  int height = cinfo->image_height;
+  int thinnest = thinnestBorder(width, height, frame_percentage);
+
+  // 1/8 unless the picture gets too small, or its frame gets empty
+  cinfo->scale_num = 1;
+  cinfo->scale_denom = 8;
+  while(cinfo->scale_denom > 1){
+    int denom = cinfo->scale_denom;
+    int scaled_width = (width + denom - 1)/denom;
+    int scaled_height = (height + denom - 1)/denom;
+    int too_small = fast_jpeg == COLORFLOW_JPEG_SCALED && (scaled_width < JPEG_MIN_SCALED_SIZE || scaled_height < JPEG_MIN_SCALED_SIZE);
+    if(!too_small && (thinnest == 0 || thinnestBorder(scaled_width, scaled_height, frame_percentage) > 0)){
+      break;
+    }
+    cinfo->scale_denom /= 2;
+  }
+}
+
+/// @brief check whether the DC coefficients of every component of a progressive jpeg picture are complete
+/// @param cinfo jpeg structure in buffered image mode that has just read the header of a scan
+/// @return 1 when the scans before the current one hold every DC coefficient, 0 otherwise
+static int jpegDCComplete(j_decompress_ptr cinfo){
+  // The current scan has set its bits before being read, a DC scan may still be refining them
+  if(cinfo->Ss == 0){
+    return 0;
+  }
+  for(int c=0; c<cinfo->num_components; c++){
+    if(cinfo->coef_bits[c][0] != 0){
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/// @brief read a jpeg file and feed the scanlines into border accumulators, without storing the whole picture
+/// @param ctx context of the computation
+/// @param file binary file of a jpeg picture
+/// @param average_RGBA array we want to store the average RGBA color into
+/// @return COLORFLOW_OK or an error code
+static int read_jpg_frame_color(colorflow_ctx *ctx, FILE *file, int *average_RGBA){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int read_jpg_frame_color(colorflow_ctx *ctx, FILE *file, int *average_RGBA)");
+  }
+
+  // Structure for JPEG picture, reused from one picture to the next
+  colorflow_decoders *decoders = getDecoders(ctx);
+  if(!decoders){
+    return COLORFLOW_ERROR_MALLOC;
+  }
+  j_decompress_ptr cinfo = &decoders->cinfo;
+  if(setjmp(decoders->jerr.setjmp_buffer)){
+    jpeg_abort_decompress(cinfo);
+    return COLORFLOW_ERROR_BAD_FILE;
+  }
+
+  // Link with JPEG file, or with the picture stored in memory
+  if(ctx->data){
+    jpeg_mem_src(cinfo, ctx->data, ctx->size);
+  }
+  else{
+    jpeg_stdio_src(cinfo, file);
+  }
+
+  // Reading headers
+  (void) jpeg_read_header(cinfo, TRUE);
+
+  // Grayscale, RGB and YCbCr pictures are converted to RGBA by the library
+  int rgba = setJpegRGBAOutput(cinfo);
+
+  // The library decodes a smaller picture, at 1/8 it only uses the DC coefficient of each 8x8 block
+  int fast_jpeg = ctx->options.fast_jpeg;
+  if(fast_jpeg != COLORFLOW_JPEG_EXACT){
+    setJpegScale(cinfo, fast_jpeg, ctx->table ? ctx->table->smallest_percentage : ctx->options.frame_percentage);
+  }
+
+  // Progressive pictures are entirely entropy decoded before the first scanline anyway,
+  // keeping the coefficients allows several output passes that only decode the frame
+  int multiple_scans = jpeg_has_multiple_scans(cinfo);
+  cinfo->buffered_image = multiple_scans;
+  // The missing AC coefficients of the DC scans are not estimated, they are not used at 1/8
+  if(fast_jpeg == COLORFLOW_JPEG_DC){
+    cinfo->do_block_smoothing = FALSE;
+  }
+
+  // Start decompress
+  (void) jpeg_start_decompress(cinfo);
+  profileLap(ctx, COLORFLOW_STAGE_HEADER, 0);
+
+  // Reading pictures informations
+  int width = ctx->width = cinfo->output_width;
+  int height = ctx->height = cinfo->output_height;
+
+  // RGBA scanlines are written straight into the row of pixels, the other ones need a buffer
+  JSAMPARRAY buffer = NULL;
+  if(!rgba){
+    buffer = (*cinfo->mem->alloc_sarray)((j_common_ptr) cinfo, JPOOL_IMAGE, width * cinfo->output_components, 1);
+  }
+  int code = allocateRow(ctx);
+  if(code != COLORFLOW_OK){
+    jpeg_abort_decompress(cinfo);
+    return code;
+  }
+  pixel* row = ctx->row;
+
+  border_accumulator accumulator;
+  code = startFrame(ctx, &accumulator);
+  if(code != COLORFLOW_OK){
+    jpeg_abort_decompress(cinfo);
+    return code;
+  }
+
+  int skipped_scans = 0;
+  if(!multiple_scans){
+    // Sequential pictures have to be entropy decoded row after row, the rows are streamed,
+    // the rows left out by the sampling are skipped without being converted
+    while((int)cinfo->output_scanline < height){
+      int y = cinfo->output_scanline;
+      int next = nextSampledRow(&accumulator, y);
+      if(next > y){
+        (void) jpeg_skip_scanlines(cinfo, (next < height ? next : height) - y);
+        continue;
+      }
+      read_jpg_scanline(ctx, cinfo, buffer, row);
+      accumulateRow(&accumulator, y, row);
+      profileLap(ctx, COLORFLOW_STAGE_ACCUMULATE, (size_t)width*sizeof(pixel));
+    }
+  }
+  else{
+    // The DC scans come first in progressive pictures, the AC scans are not read in DC mode,
+    // without AC coefficients each block is decoded as its mean at every scale
+    int status;
+    while((status = jpeg_consume_input(cinfo)) != JPEG_REACHED_EOI){
+      if(status == JPEG_REACHED_SOS && fast_jpeg == COLORFLOW_JPEG_DC && jpegDCComplete(cinfo)){
+        skipped_scans = 1;
+        break;
+      }
+    }
+    profileLap(ctx, COLORFLOW_STAGE_SCANLINES, 0);
+
+    // The output passes use the scans that have been entirely read
+    int scan = skipped_scans ? cinfo->input_scan_number - 1 : cinfo->input_scan_number;
+
+    // Rows between the upper and lower borders only need their left and right spans
+    int middle_start = accumulator.up_end;
+    int middle_end = accumulator.down_start;
+    // Frame tables and zones need the columns or rows of the spans, which the cropped passes add straight into the sums
+    int crop_middle = middle_start < middle_end && accumulator.left_end < accumulator.right_start && !accumulator.table && !accumulator.zones;
+
+    // First pass on full rows, the middle band is skipped when it can be cropped
+    (void) jpeg_start_output(cinfo, scan);
+    while((int)cinfo->output_scanline < height){
+      int y = cinfo->output_scanline;
+      if(crop_middle && y == middle_start){
+        (void) jpeg_skip_scanlines(cinfo, middle_end - middle_start);
+        continue;
+      }
+      int next = nextSampledRow(&accumulator, y);
+      if(next > y){
+        int end = crop_middle && y < middle_start ? middle_start : height;
+        (void) jpeg_skip_scanlines(cinfo, (next < end ? next : end) - y);
+        continue;
+      }
+      read_jpg_scanline(ctx, cinfo, buffer, row);
+      accumulateRow(&accumulator, y, row);
+      profileLap(ctx, COLORFLOW_STAGE_ACCUMULATE, (size_t)width*sizeof(pixel));
+    }
+    (void) jpeg_finish_output(cinfo);
+
+    // One cropped pass for each side of the middle band
+    if(crop_middle){
+      read_jpg_span(ctx, cinfo, scan, buffer, row, width, &accumulator, BORDER_LEFT, middle_start, middle_end, 0, accumulator.left_end);
+      read_jpg_span(ctx, cinfo, scan, buffer, row, width, &accumulator, BORDER_RIGHT, middle_start, middle_end, accumulator.right_start, width);
+    }
+  }
+
+  // Finish decompress, the rest of a picture whose AC scans are skipped is not read
+  if(skipped_scans){
+    jpeg_abort_decompress(cinfo);
+  }
+  else{
+    (void) jpeg_finish_decompress(cinfo);
+  }
+  profileLap(ctx, COLORFLOW_STAGE_SCANLINES, 0);
+
+  finishFrame(ctx, &accumulator, average_RGBA);
+
+  // The dimensions of the result are the ones of the picture, even when it has been scaled
+  ctx->width = cinfo->image_width;
+  ctx->height = cinfo->image_height;
+  return COLORFLOW_OK;
+}
+
+/******************************************************************************************************************************************************************************
+ *                                                                                                                                                                            *
+ *                 Reading BMP files, all the following part is inspired by example code of libnsbmp http://source.netsurf-browser.org/libnsbmp.git/                          *
+ *                                                                                                                                                                            *
+*******************************************************************************************************************************************************************************/
+
+#define BYTES_PER_PIXEL 4
+
+// Bitmap handed to libnsbmp, its buffer is set to the matrix of pixels of the context once the dimensions are known
+typedef struct{
+  unsigned char *buffer;
+} bmp_target;
+
+static void *bitmap_create(int width, int height, unsigned int state)
+{
+  (void) width;  /* unused, the size of the matrix of pixels is checked by allocatePixels */
+  (void) height;
+  (void) state;  /* unused, the buffer is cleared by decode_bmp_pixels when needed */
+  return calloc(1, sizeof(bmp_target));
+}
+
+
+static unsigned char *bitmap_get_buffer(void *bitmap)
+{
+  assert(bitmap);
+  return ((bmp_target*)bitmap)->buffer;
+}
+
+
+static size_t bitmap_get_bpp(void *bitmap)
+{
+  (void) bitmap;  /* unused */
+  return BYTES_PER_PIXEL;
+}
+
+
+static void bitmap_destroy(void *bitmap)
+{
+  assert(bitmap);
+  free(bitmap);
+}
+
+/// @brief map a bmp file in memory instead of reading it
+/// @param ctx context that holds the size of the file
+/// @param fd binary file of a bmp picture, NULL for a picture stored in memory
+/// @return read only mapping of the file, or the picture stored in memory, NULL on error
+static unsigned char *map_bmp_file(colorflow_ctx *ctx, FILE *fd)
+{
+  if(ctx->options.debug_mode){
+    char debugInfo[100];
+    sprintf(debugInfo, "static unsigned char *map_bmp_file(colorflow_ctx *ctx, FILE *fd), size = %ld",ctx->size);
+    displayDebugInfo(debugInfo);
+  }
+
+  if (ctx->size == 0) {
+    return NULL;
+  }
+  // libnsbmp reads a picture stored in memory where it is
+  if (ctx->data) {
+    return (unsigned char*)ctx->data;
+  }
+  void *data = mmap(NULL, ctx->size, PROT_READ, MAP_PRIVATE, fileno(fd), 0);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+  return (unsigned char*)data;
+}
+
+/// @brief release a bmp structure and the mapping of its file
+/// @param ctx context that holds the size of the file
+/// @param bmp bmp structure set up by open_bmp_file
+/// @param data mapping of the file, or the picture stored in memory
+static void close_bmp_file(colorflow_ctx *ctx, bmp_image *bmp, unsigned char *data){
+  bmp_finalise(bmp);
+  if (!ctx->data) {
+    munmap(data, ctx->size);
+  }
+}
+
+/// @brief map a bmp file and analyse its header, the picture is not decoded
+/// @param ctx context we want to store the dimensions of the picture into
+/// @param file binary file of a bmp picture
+/// @param bmp bmp structure to set up, to be released by close_bmp_file on success
+/// @param data pointer to store the mapping of the file into
+/// @return COLORFLOW_OK or an error code
+static int open_bmp_file(colorflow_ctx *ctx, FILE *file, bmp_image *bmp, unsigned char **data){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int open_bmp_file(colorflow_ctx *ctx, FILE *file, bmp_image *bmp, unsigned char **data)");
+  }
+
+  bmp_bitmap_callback_vt bitmap_callbacks = {
+    bitmap_create,
+    bitmap_destroy,
+    bitmap_get_buffer,
+    bitmap_get_bpp
+  };
+
+  /* create our bmp image */
+  bmp_create(bmp, &bitmap_callbacks);
+
+  /* map the file into memory, libnsbmp only reads it */
+  *data = map_bmp_file(ctx, file);
+  if (!*data) {
+    return COLORFLOW_ERROR_BAD_FILE;
+  }
+
+  /* analyse the BMP, whose sizes are stored on 32 bits */
+  bmp_result code = bmp_analyse(bmp, ctx->size > UINT32_MAX ? UINT32_MAX : ctx->size, *data);
+  if (code != BMP_OK) {
+    close_bmp_file(ctx, bmp, *data);
+    return (code == BMP_INSUFFICIENT_MEMORY) ? COLORFLOW_ERROR_MALLOC : COLORFLOW_ERROR_BAD_FILE;
+  }
+
+  ctx->height = bmp->height;
+  ctx->width = bmp->width;
+  profileLap(ctx, COLORFLOW_STAGE_HEADER, 0);
+  return COLORFLOW_OK;
+}
+
+/// @brief decode an analysed bmp picture into the matrix of pixels of the context
+/// @param ctx context of the computation
+/// @param bmp bmp structure set up by open_bmp_file
+/// @return COLORFLOW_OK or an error code
+/// @authors code inspired by http://source.netsurf-browser.org/libnsbmp.git/
+static int decode_bmp_pixels(colorflow_ctx *ctx, bmp_image *bmp){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int decode_bmp_pixels(colorflow_ctx *ctx, bmp_image *bmp)");
+  }
+
+  // libnsbmp decodes straight into the matrix of pixels
+  int result = allocatePixels(ctx);
+  if (result != COLORFLOW_OK) {
+    return result;
+  }
+  // libnsbmp writes its rows width pixels apart, at the start of the matrix
+  size_t image_size = (size_t)ctx->height * ctx->width * sizeof(pixel);
+  unsigned char *image = (unsigned char*)ctx->pixels;
+  ((bmp_target*)bmp->bitmap)->buffer = image;
+
+  // Bitfields are or-ed into the pixels and RLE pictures can skip pixels, both expect a cleared bitmap
+  int sparse = bmp->encoding == BMP_ENCODING_RLE8 || bmp->encoding == BMP_ENCODING_RLE4;
+  if (sparse || bmp->encoding == BMP_ENCODING_BITFIELDS) {
+    memset(image, 0, image_size);
+    profileLap(ctx, COLORFLOW_STAGE_REPACK, image_size);
+  }
+
+  // The rows of a mapped file are read once, from the first to the last
+  if (!ctx->data) {
+    madvise(bmp->bmp_data, bmp->buffer_size, MADV_SEQUENTIAL);
+  }
+
+  /* decode the image */
+  bmp_result code = bmp_decode(bmp);
+  if (code != BMP_OK) {
+    return (code == BMP_INSUFFICIENT_MEMORY) ? COLORFLOW_ERROR_MALLOC : COLORFLOW_ERROR_BAD_FILE;
+  }
+  profileLap(ctx, COLORFLOW_STAGE_SCANLINES, image_size);
+
+  // The rows are moved to their aligned stride from the last one, which moves the furthest, so no row is overwritten before it is moved
+  // The alpha channel of bmp pictures is not used, skipped pixels and alpha masks are made opaque
+  int opaque = sparse || !bmp->opaque;
+  if (ctx->stride != (size_t)ctx->width || opaque) {
+    for (int y = ctx->height - 1; y >= 0; y--) {
+      pixel *row = pixelRow(ctx, y);
+      memmove(row, ctx->pixels + (size_t)y*ctx->width, ctx->width*sizeof(pixel));
+      for (int x = 0; opaque && x < ctx->width; x++) {
+        row[x].alpha = 255;
+      }
+    }
+    profileLap(ctx, COLORFLOW_STAGE_REPACK, image_size);
+  }
+  return COLORFLOW_OK;
+}
+
+/// @brief read a bmp file and store the RGBA values of each pixel in the matrix of pixels of the context
+/// @param ctx context of the computation
+/// @param file binary file of a bmp picture
+/// @return COLORFLOW_OK or an error code
+static int read_bmp_file(colorflow_ctx *ctx, FILE *file){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int read_bmp_file(colorflow_ctx *ctx, FILE *file)");
+  }
+
+  bmp_image bmp;
+  unsigned char *data;
+  int result = open_bmp_file(ctx, file, &bmp, &data);
+  if (result != COLORFLOW_OK) {
+    return result;
+  }
+
+  result = decode_bmp_pixels(ctx, &bmp);
+
+  close_bmp_file(ctx, &bmp, data);
+  profileLap(ctx, COLORFLOW_STAGE_OPEN, 0);
+  return result;
+}
+
+/// @brief colour of an index of the palette of a bmp picture
+/// @param bmp bmp structure that holds the colour table
+/// @param index index of the palette
+/// @return opaque pixel, black when the index is out of the palette
+static pixel read_bmp_colour(bmp_image *bmp, uint32_t index){
+  pixel p = createPixel(0, 0, 0, 255);
+  if (index < bmp->colours) {
+    // The colour table has the layout of a pixel
+    memcpy(&p, &bmp->colour_table[index], sizeof(pixel));
+    p.alpha = 255;
+  }
+  return p;
+}
+
+/// @brief convert a pixel stored with bitfields into a RGBA pixel, as bmp_decode does
+/// @param bmp bmp structure that holds the masks and shifts of the components
+/// @param word pixel read from the file
+/// @return opaque pixel
+static pixel read_bmp_bitfields(bmp_image *bmp, uint32_t word){
+  uint32_t value = 0;
+  for (int i = 0; i < 3; i++) {
+    if (bmp->shift[i] > 0)
+      value |= (word & bmp->mask[i]) << bmp->shift[i];
+    else
+      value |= (word & bmp->mask[i]) >> (-bmp->shift[i]);
+  }
+  return createPixel(value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, 255);
+}
+
+/// @brief convert a span of a row of an uncompressed bmp picture into RGBA pixels
+/// @param bmp bmp structure analysed by open_bmp_file
+/// @param data first byte of the row in the file
+/// @param row row of pixels we want to store the RGBA values into
+/// @param start_column specifies on which column the span starts
+/// @param end_column specifies on which column the span ends
+static void read_bmp_span(bmp_image *bmp, uint8_t *data, pixel *row, int start_column, int end_column){
+  int bitfields = bmp->encoding == BMP_ENCODING_BITFIELDS;
+
+  if (bmp->bpp == 24 || bmp->bpp == 32) {
+    int skip = bmp->bpp >> 3;
+    for (int x = start_column; x < end_column; x++) {
+      uint8_t *p = data + (size_t)x*skip;
+      if (bitfields)
+        row[x] = read_bmp_bitfields(bmp, p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+      else
+        row[x] = createPixel(p[2], p[1], p[0], 255);
+    }
+  }
+  else if (bmp->bpp == 16) {
+    for (int x = start_column; x < end_column; x++) {
+      uint16_t word = data[2*x] | (data[2*x + 1] << 8);
+      if (bitfields)
+        row[x] = read_bmp_bitfields(bmp, word);
+      else
+        /* 16-bit RGB defaults to RGB555 */
+        row[x] = createPixel(((word >> 10) & 31) << 3, ((word >> 5) & 31) << 3, (word & 31) << 3, 255);
+    }
+  }
+  else {
+    // Palette indexes, the first one of a byte is in its high bits
+    int ppb = 8 / bmp->bpp;
+    int bit_mask = (1 << bmp->bpp) - 1;
+    for (int x = start_column; x < end_column; x++) {
+      int shift = 8 - ((x % ppb) + 1) * bmp->bpp;
+      row[x] = read_bmp_colour(bmp, (data[x / ppb] >> shift) & bit_mask);
+    }
+  }
+}
+
+/// @brief feed the rows of an uncompressed bmp picture into border accumulators straight from the file,
+/// only the rows and spans of the frame are converted
+/// @param ctx context of the computation
+/// @param bmp bmp structure analysed by open_bmp_file
+/// @param average_RGBA array we want to store the average RGBA color into
+/// @return COLORFLOW_OK or an error code
+static int read_bmp_frame_rows(colorflow_ctx *ctx, bmp_image *bmp, int *average_RGBA){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int read_bmp_frame_rows(colorflow_ctx *ctx, bmp_image *bmp, int *average_RGBA)");
+  }
+
+  int width = ctx->width;
+  int height = ctx->height;
+
+  // Rows are padded to 4 bytes, the last one may not be
+  size_t row_bytes = ((size_t)width * bmp->bpp + 7) / 8;
+  size_t stride = (row_bytes + 3) & ~(size_t)3;
+  if (bmp->bitmap_offset + stride * (height - 1) + row_bytes > bmp->buffer_size) {
+    return COLORFLOW_ERROR_BAD_FILE;
+  }
+  uint8_t *rows = bmp->bmp_data + bmp->bitmap_offset;
+
+  int code = allocateRow(ctx);
+  border_accumulator accumulator;
+  if (code == COLORFLOW_OK) {
+    code = startFrame(ctx, &accumulator);
+  }
+  if (code != COLORFLOW_OK) {
+    return code;
+  }
+  pixel *row = ctx->row;
+
+  // Rows are read where they are stored, the rows left out by the sampling are not converted
+  for (int y = nextSampledRow(&accumulator, 0); y < height; y = nextSampledRow(&accumulator, y + 1)) {
+    // Rows are stored from the bottom to the top unless the height is negative
+    uint8_t *data = rows + stride * (bmp->reversed ? y : height - 1 - y);
+    if (y < accumulator.up_end || y >= accumulator.down_start) {
+      read_bmp_span(bmp, data, row, 0, width);
+      profileLap(ctx, COLORFLOW_STAGE_REPACK, (size_t)width*sizeof(pixel));
+    }
+    else {
+      // Only the left and right spans of the middle rows are converted
+      read_bmp_span(bmp, data, row, 0, accumulator.left_end);
+      read_bmp_span(bmp, data, row, accumulator.right_start, width);
+      profileLap(ctx, COLORFLOW_STAGE_REPACK, (size_t)(accumulator.left_end + width - accumulator.right_start)*sizeof(pixel));
+    }
+    accumulateRow(&accumulator, y, row);
+    profileLap(ctx, COLORFLOW_STAGE_ACCUMULATE, (size_t)width*sizeof(pixel));
+  }
+
+  finishFrame(ctx, &accumulator, average_RGBA);
+  return COLORFLOW_OK;
+}
+
+/// @brief give the rows of a RLE bmp picture up to a row to border accumulators, the row buffer then holds the next row
+/// @param ctx context of the computation
+/// @param bmp bmp structure analysed by open_bmp_file
+/// @param accumulator border accumulator
+/// @param row row buffer, cleared to opaque black for the next row
+/// @param flushed number of rows already given, from the start of the file
+/// @param y first row of the file that is not complete yet
+static void flush_bmp_rle_rows(colorflow_ctx *ctx, bmp_image *bmp, border_accumulator *accumulator, pixel *row, uint32_t *flushed, uint32_t y){
+  pixel black = createPixel(0, 0, 0, 255);
+  while (*flushed < y && *flushed < bmp->height) {
+    // Rows are stored from the bottom to the top unless the height is negative
+    profileLap(ctx, COLORFLOW_STAGE_SCANLINES, (size_t)bmp->width*sizeof(pixel));
+    accumulateRow(accumulator, bmp->reversed ? *flushed : bmp->height - 1 - *flushed, row);
+    profileLap(ctx, COLORFLOW_STAGE_ACCUMULATE, (size_t)bmp->width*sizeof(pixel));
+    for (uint32_t x = 0; x < bmp->width; x++) {
+      row[x] = black;
+    }
+    (*flushed)++;
+  }
+}
+
+/// @brief feed the rows of a RLE bmp picture into border accumulators as they are decoded, without storing the whole picture
+/// @param ctx context of the computation
+/// @param bmp bmp structure analysed by open_bmp_file
+/// @param average_RGBA array we want to store the average RGBA color into
+/// @return COLORFLOW_OK or an error code
+/// @authors code adapted from bmp_decode_rle of http://source.netsurf-browser.org/libnsbmp.git/
+static int read_bmp_rle_rows(colorflow_ctx *ctx, bmp_image *bmp, int *average_RGBA){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int read_bmp_rle_rows(colorflow_ctx *ctx, bmp_image *bmp, int *average_RGBA)");
+  }
+
+  int code = allocateRow(ctx);
+  border_accumulator accumulator;
+  if (code == COLORFLOW_OK) {
+    code = startFrame(ctx, &accumulator);
+  }
+  if (code != COLORFLOW_OK) {
+    return code;
+  }
+
+  int size = bmp->encoding == BMP_ENCODING_RLE8 ? 8 : 4;
+  uint8_t *data = bmp->bmp_data + bmp->bitmap_offset;
+  uint8_t *end = bmp->bmp_data + bmp->buffer_size;
+  pixel *row = ctx->row;
+  uint32_t width = bmp->width;
+  uint32_t height = bmp->height;
+  uint32_t x = 0, y = 0, last_y = 0, flushed = 0;
+  uint32_t i, length;
+  pixel colour, colour2;
+
+  // Pixels skipped by the picture are opaque black, as in a decoded picture
+  for (i = 0; i < width; i++) {
+    row[i] = createPixel(0, 0, 0, 255);
+  }
+
+  do {
+    if (data + 2 > end)
+      return COLORFLOW_ERROR_BAD_FILE;
+    length = *data++;
+    if (length == 0) {
+      length = *data++;
+      if (length == 0) {
+        /* 00 - 00 means end of scanline */
+        x = 0;
+        if (last_y == y) {
+          if (++y > height)
+            return COLORFLOW_ERROR_BAD_FILE;
+        }
+        last_y = y;
+      } else if (length == 1) {
+        /* 00 - 01 means end of RLE data */
+        break;
+      } else if (length == 2) {
+        /* 00 - 02 - XX - YY means move cursor */
+        if (data + 2 > end)
+          return COLORFLOW_ERROR_BAD_FILE;
+        x += *data++;
+        if (x >= width)
+          return COLORFLOW_ERROR_BAD_FILE;
+        y += *data++;
+        if (y >= height)
+          return COLORFLOW_ERROR_BAD_FILE;
+      } else {
+        /* 00 - NN means escape NN pixels */
+        if (data + length > end)
+          return COLORFLOW_ERROR_BAD_FILE;
+        flush_bmp_rle_rows(ctx, bmp, &accumulator, row, &flushed, y);
+        uint32_t value = 0;
+        for (i = 0; i < length; i++) {
+          if (x >= width) {
+            x = 0;
+            if (++y > height)
+              return COLORFLOW_ERROR_BAD_FILE;
+            flush_bmp_rle_rows(ctx, bmp, &accumulator, row, &flushed, y);
+          }
+          if (size == 8)
+            value = *data++;
+          else if ((i & 1) == 0)
+            value = *data++;
+          colour = read_bmp_colour(bmp, size == 8 ? value : (i & 1) ? value & 0xf : value >> 4);
+          if (y < height)
+            row[x] = colour;
+          x++;
+        }
+        if (size == 4)
+          length = (length + 1) >> 1;
+        if ((length & 1) && (*data++ != 0x00))
+          return COLORFLOW_ERROR_BAD_FILE;
+      }
+    } else {
+      /* NN means perform RLE for NN pixels */
+      if (data + 1 > end)
+        return COLORFLOW_ERROR_BAD_FILE;
+      flush_bmp_rle_rows(ctx, bmp, &accumulator, row, &flushed, y);
+      if (size == 8) {
+        colour = colour2 = read_bmp_colour(bmp, *data++);
+      } else {
+        colour = read_bmp_colour(bmp, *data >> 4);
+        colour2 = read_bmp_colour(bmp, *data++ & 0xf);
+      }
+      for (i = 0; i < length; i++) {
+        if (x >= width) {
+          x = 0;
+          if (++y > height)
+            return COLORFLOW_ERROR_BAD_FILE;
+          flush_bmp_rle_rows(ctx, bmp, &accumulator, row, &flushed, y);
+        }
+        if (y < height)
+          row[x] = (i & 1) ? colour2 : colour;
+        x++;
+      }
+    }
+  } while (data < end);
+
+  // The rows after the end of the data are black
+  flush_bmp_rle_rows(ctx, bmp, &accumulator, row, &flushed, height);
+
+  finishFrame(ctx, &accumulator, average_RGBA);
+  return COLORFLOW_OK;
+}
+
+/// @brief read a bmp file and feed its rows into border accumulators, uncompressed pictures are not decoded outside of their frame
+/// @param ctx context of the computation
+/// @param file binary file of a bmp picture
+/// @param average_RGBA array we want to store the average RGBA color into
+/// @return COLORFLOW_OK or an error code
+static int read_bmp_frame_color(colorflow_ctx *ctx, FILE *file, int *average_RGBA){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int read_bmp_frame_color(colorflow_ctx *ctx, FILE *file, int *average_RGBA)");
+  }
+
+  bmp_image bmp;
+  unsigned char *data;
+  int code = open_bmp_file(ctx, file, &bmp, &data);
+  if (code != COLORFLOW_OK) {
+    return code;
+  }
+
+  if (bmp.encoding == BMP_ENCODING_RGB || bmp.encoding == BMP_ENCODING_BITFIELDS) {
+    code = read_bmp_frame_rows(ctx, &bmp, average_RGBA);
+  }
+  else {
+    code = read_bmp_rle_rows(ctx, &bmp, average_RGBA);
+  }
+
+  close_bmp_file(ctx, &bmp, data);
+  profileLap(ctx, COLORFLOW_STAGE_OPEN, 0);
+  return code;
+}
+
+/// @brief Return the average color of of a certain rectangular area of an image determined by start_row, end_row, start_column, end_column
+/// @param ctx context of the computation
+/// @param pixels_image matrix of pixels
+/// @param stride number of pixels from one row of the matrix to the next
+/// @param border_average_color array we want to store the average RGBA color into
+/// @param start_row specifies on which row the area starts
+/// @param end_row specifies on which row the area ends
+/// @param start_column specifies on which column the area starts
+/// @param end_column specifies on which column the area ends
+void getAverageBorderColor(colorflow_ctx *ctx, pixel *pixels_image, size_t stride, int *border_average_color, int start_row, int end_row, int start_column, int end_column){
+
+  if(ctx->options.debug_mode){
+    char debugInfo[200];
+    sprintf(debugInfo,"void getAverageBorderColor(colorflow_ctx *ctx, pixel *pixels_image, size_t stride, int *border_average_color, int start_row = %d, int end_row = %d, int start_column = %d, int end_column = %d)",start_row, end_row,start_column,end_column);
+    displayDebugInfo(debugInfo);
+  }
+
+  // establishing average color of the selected border
+  int64_t pixel_amount = ((int64_t)(end_row-start_row)*(end_column-start_column));
+
+  // Measure to avoid division by 0
+  if(pixel_amount == 0){
+    pixel_amount = 1;
+  }
+
+  // Summing the values of each pixel on 64 bits
+  int64_t sums[4] = {0,0,0,0};
+  for(int y=start_row; y<end_row; y++){
+    sumRow(sums, pixels_image + (size_t)y*stride, start_column, end_column);
+  }
+
+  // Dividing each component by the number of pixels
+  for(int i=0;i<4;i++){
+    border_average_color[i] = (int)((border_average_color[i] + sums[i]) / pixel_amount);
+  }
+}
+
+/// @brief determine the RGBA average color of the specified border
+/// @param ctx context that holds the dimensions of the picture
+/// @param pixels_image matrix of pixels
+/// @param stride number of pixels from one row of the matrix to the next
+/// @param frame_percentage percentage of the border to calculate the average RGBA
+/// @param average_RGBA array we want to store the average RGBA color into
+void getAverageColor(colorflow_ctx *ctx, pixel *pixels_image, size_t stride, float frame_percentage, int *average_RGBA){
+
+  if(ctx->options.debug_mode){
+    char debugInfo[150];
+    sprintf(debugInfo, "void getAverageColor(colorflow_ctx *ctx, pixel *pixels_image, size_t stride, float frame_percentage = %f, int *average_RGBA)",frame_percentage);
+    displayDebugInfo(debugInfo);
+  }
+
+  // Single pass over the rows, each row is read once and added to the borders it belongs to
+  // The left and right borders are summed along the rows instead of down the columns
+  border_accumulator accumulator;
+  initBorderAccumulator(ctx, &accumulator, frame_percentage);
+
+  // Only the rows of the upper and lower borders are read whole, the others are read on their spans
+  for(int y=nextSampledRow(&accumulator, 0); y<ctx->height; y=nextSampledRow(&accumulator, y+1)){
+    accumulateRow(&accumulator, y, pixels_image + (size_t)y*stride);
+  }
+
+  // Each border is divided by its own number of pixels before the four are averaged, as with getAverageBorderColor
+  computeAverageColor(ctx, &accumulator, average_RGBA);
+}
+
+/// @brief decode a whole picture by calling the right function depends on its format
+/// @param ctx context we want to store the matrix of pixels into
+/// @param file binary file of the picture to open
+/// @param buffer first characters of the binary file that contains the signature of the format
+/// @return COLORFLOW_OK or an error code
+static int read_data(colorflow_ctx *ctx, FILE *file, unsigned char* buffer){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int read_data(colorflow_ctx *ctx, FILE *file, unsigned char* buffer)");
+  }
+
+  // Compare with png signature
+  if (png_sig_cmp(buffer, 0, 8) == 0) {
+    return read_png_file(ctx, file);
+  } // Compare with jpg signature
+  else if (buffer[0] == 0xFF && buffer[1] == 0xD8 && buffer[2] == 0xFF) {
+    return read_jpg_file(ctx, file);
+  } // Compare with bmp signature
+  else if (buffer[0] == 'B' && buffer[1] == 'M') {
+    return read_bmp_file(ctx, file);
+  } // Compare with heif signature
+  else {
+    return COLORFLOW_ERROR_UNSUPPORTED_FILE_FORMAT;
+  }
+}
+
+/// @brief determine the RGBA average color of the frame of a picture, streaming the rows when the format allows it
+/// @param ctx context of the computation
+/// @param file binary file of the picture to open
+/// @param buffer first characters of the binary file that contains the signature of the format
+/// @param average_RGBA array we want to store the average RGBA color into
+/// @return COLORFLOW_OK or an error code
+static int getFrameColor(colorflow_ctx *ctx, FILE *file, unsigned char* buffer, int *average_RGBA){
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("static int getFrameColor(colorflow_ctx *ctx, FILE *file, unsigned char* buffer, int *average_RGBA)");
+  }
+
+  // PNG rows, JPEG scanlines and BMP rows are streamed into the border accumulators, no other format is known
+  if (png_sig_cmp(buffer, 0, 8) == 0) {
+    return read_png_frame_color(ctx, file, average_RGBA);
+  }
+  if (buffer[0] == 0xFF && buffer[1] == 0xD8 && buffer[2] == 0xFF) {
+    return read_jpg_frame_color(ctx, file, average_RGBA);
+  }
+  if (buffer[0] == 'B' && buffer[1] == 'M') {
+    return read_bmp_frame_color(ctx, file, average_RGBA);
+  }
+
+  return COLORFLOW_ERROR_UNSUPPORTED_FILE_FORMAT;
+}
+
+/// @brief open a picture, read its signature and rewind it
+/// @param ctx context we want to store the size of the file, or the picture stored in memory, into
+/// @param path path of the picture, NULL for a picture stored in memory
+/// @param data picture stored in memory
+/// @param size size of the picture stored in memory
+/// @param buffer array we want to store the first 8 bytes of the file into
+/// @param code pointer to store COLORFLOW_OK or an error code into
+/// @return opened file, NULL for a picture stored in memory or on error
+static FILE *open_picture(colorflow_ctx *ctx, const char *path, const void *data, size_t size, unsigned char *buffer, int *code){
+  struct stat sb;
+
+  profileStart(ctx);
+
+  // The decoders read a picture stored in memory where it is, its signature is its first bytes
+  if(!path){
+    if(size < 8){
+      *code = COLORFLOW_ERROR_BAD_FILE;
+      return NULL;
+    }
+    ctx->data = (const unsigned char*)data;
+    ctx->size = size;
+    profileLap(ctx, COLORFLOW_STAGE_OPEN, size);
+    memcpy(buffer, data, 8);
+    profileLap(ctx, COLORFLOW_STAGE_SNIFF, 8);
+    *code = COLORFLOW_OK;
+    return NULL;
+  }
+
+  FILE *file = fopen(path, "rb");
+  if(!file){
+    *code = COLORFLOW_ERROR_OPEN_FAILED;
+    return NULL;
+  }
+
+  if (fstat(fileno(file), &sb)) {
+    fclose(file);
+    *code = COLORFLOW_ERROR_BAD_FILE;
+    return NULL;
+  }
+  ctx->size = sb.st_size;
+  profileLap(ctx, COLORFLOW_STAGE_OPEN, ctx->size);
+
+  // Reading the first bytes of the binary file and store it in an array
+  if(fread(buffer, 1, 8, file) != 8){
+    fclose(file);
+    *code = COLORFLOW_ERROR_BAD_FILE;
+    return NULL;
+  }
+
+  // Reseting the pointer at the begining of the file
+  if(fseek(file,0,SEEK_SET)){
+    fclose(file);
+    *code = COLORFLOW_ERROR_BAD_FILE;
+    return NULL;
+  }
+  profileLap(ctx, COLORFLOW_STAGE_SNIFF, 8);
+
+  *code = COLORFLOW_OK;
+  return file;
+}
+
+/// @brief close a picture opened by open_picture
+/// @param ctx context of the computation
+/// @param file opened file, NULL for a picture stored in memory
+static void close_picture(colorflow_ctx *ctx, FILE *file){
+  if(file){
+    fclose(file);
+  }
+  ctx->data = NULL;
+  profileLap(ctx, COLORFLOW_STAGE_OPEN, 0);
+}
+
+/// @brief determine the RGBA average color of the frame of a picture stored in a file or in memory
+/// @param ctx context created by colorflow_ctx_create
+/// @param path path of the picture, NULL for a picture stored in memory
+/// @param data picture stored in memory
+/// @param size size of the picture stored in memory
+/// @param opts options of the computation
+/// @param out result we want to store the dimensions and the average RGBA color into
+/// @return COLORFLOW_OK or an error code
+static int computePicture(colorflow_ctx *ctx, const char *path, const void *data, size_t size, const colorflow_options *opts, colorflow_result *out){
+
+  ctx->options = *opts;
+
+  if(opts->frame_percentage > 1.0 || opts->frame_percentage <= 0.0){
+    return COLORFLOW_ERROR_BAD_PERCENTAGE;
+  }
+
+  int code;
+  unsigned char buffer[8];
+  FILE *file = open_picture(ctx, path, data, size, buffer, &code);
+  if(code != COLORFLOW_OK){
+    return code;
+  }
+
+  code = getFrameColor(ctx, file, buffer, out->average_RGBA);
+
+  close_picture(ctx, file);
+
+  out->width = ctx->width;
+  out->height = ctx->height;
+  memcpy(out->standard_error, ctx->standard_error, sizeof(out->standard_error));
+  return code;
+}
+
+/// @brief determine the RGBA average color of the frame of a picture, a context can be used by only one thread at a time
+/// @param ctx context created by colorflow_ctx_create
+/// @param path path of the picture
+/// @param opts options of the computation
+/// @param out result we want to store the dimensions and the average RGBA color into
+/// @return COLORFLOW_OK or an error code
+int colorflow_compute(colorflow_ctx *ctx, const char *path, const colorflow_options *opts, colorflow_result *out){
+
+  if(opts->debug_mode){
+    char debugInfo[150];
+    sprintf(debugInfo, "int colorflow_compute(colorflow_ctx *ctx, const char *path, const colorflow_options *opts, colorflow_result *out), frame_percentage = %f",opts->frame_percentage);
+    displayDebugInfo(debugInfo);
+  }
+
+  return computePicture(ctx, path, NULL, 0, opts, out);
+}
+
+/// @brief determine the RGBA average color of the frame of a picture stored in memory, a context can be used by only one thread at a time
+/// @param ctx context created by colorflow_ctx_create
+/// @param data picture stored in memory, read where it is
+/// @param size size of the picture in bytes
+/// @param opts options of the computation
+/// @param out result we want to store the dimensions and the average RGBA color into
+/// @return COLORFLOW_OK or an error code
+int colorflow_compute_memory(colorflow_ctx *ctx, const void *data, size_t size, const colorflow_options *opts, colorflow_result *out){
+
+  if(opts->debug_mode){
+    char debugInfo[150];
+    sprintf(debugInfo, "int colorflow_compute_memory(colorflow_ctx *ctx, const void *data, size_t size = %zu, const colorflow_options *opts, colorflow_result *out)",size);
+    displayDebugInfo(debugInfo);
+  }
+
+  return computePicture(ctx, NULL, data, size, opts, out);
+}
+
+/// @brief determine the RGBA average colors of the frames of several percentages of a picture stored in a file or in memory, decoding it only once
+/// @param ctx context created by colorflow_ctx_create
+/// @param path path of the picture, NULL for a picture stored in memory
+/// @param data picture stored in memory
+/// @param size size of the picture stored in memory
+/// @param opts options of the computation, its frame_percentage is not used
+/// @param frame_percentages percentages of the border, each in ]0, 1]
+/// @param percentage_amount number of percentages
+/// @param out array of percentage_amount results we want to store the dimensions and the average RGBA colors into
+/// @return COLORFLOW_OK or an error code
+static int computePicturePercentages(colorflow_ctx *ctx, const char *path, const void *data, size_t size, const colorflow_options *opts, const float *frame_percentages, int percentage_amount, colorflow_result *out){
+
+  if(percentage_amount <= 0){
+    return COLORFLOW_ERROR_BAD_PERCENTAGE;
+  }
+
+  // A single percentage keeps the cropped decoding of the frame
+  colorflow_options options = *opts;
+  if(percentage_amount == 1){
+    options.frame_percentage = frame_percentages[0];
+    return computePicture(ctx, path, data, size, &options, out);
+  }
+
+  // The table is built on the widest frame, which holds every narrower one
+  options.frame_percentage = 0;
+  for(int i = 0; i < percentage_amount; i++){
+    if(frame_percentages[i] > 1.0 || frame_percentages[i] <= 0.0){
+      return COLORFLOW_ERROR_BAD_PERCENTAGE;
+    }
+    if(frame_percentages[i] > options.frame_percentage){
+      options.frame_percentage = frame_percentages[i];
+    }
+  }
+  ctx->options = options;
+
+  int code;
+  unsigned char buffer[8];
+  FILE *file = open_picture(ctx, path, data, size, buffer, &code);
+  if(code != COLORFLOW_OK){
+    return code;
+  }
+
+  frame_table table;
+  table.smallest_percentage = frame_percentages[0];
+  for(int i = 1; i < percentage_amount; i++){
+    if(frame_percentages[i] < table.smallest_percentage){
+      table.smallest_percentage = frame_percentages[i];
+    }
+  }
+  ctx->table = &table;
+  code = getFrameColor(ctx, file, buffer, NULL);
+  ctx->table = NULL;
+
+  close_picture(ctx, file);
+
+  for(int i = 0; i < percentage_amount; i++){
+    if(code == COLORFLOW_OK){
+      readFrameTable(ctx, &table, frame_percentages[i], out[i].average_RGBA);
+    }
+    out[i].width = ctx->width;
+    out[i].height = ctx->height;
+    memset(out[i].standard_error, 0, sizeof(out[i].standard_error));
+  }
+  profileLap(ctx, COLORFLOW_STAGE_ACCUMULATE, 0);
+  return code;
+}
+
+/// @brief determine the RGBA average colors of the frames of several percentages of a picture, decoding it only once
+/// @param ctx context created by colorflow_ctx_create
+/// @param path path of the picture
+/// @param opts options of the computation, its frame_percentage is not used
+/// @param frame_percentages percentages of the border, each in ]0, 1]
+/// @param percentage_amount number of percentages
+/// @param out array of percentage_amount results we want to store the dimensions and the average RGBA colors into
+/// @return COLORFLOW_OK or an error code
+int colorflow_compute_percentages(colorflow_ctx *ctx, const char *path, const colorflow_options *opts, const float *frame_percentages, int percentage_amount, colorflow_result *out){
+
+  if(opts->debug_mode){
+    char debugInfo[200];
+    sprintf(debugInfo, "int colorflow_compute_percentages(colorflow_ctx *ctx, const char *path, const colorflow_options *opts, const float *frame_percentages, int percentage_amount = %d, colorflow_result *out)",percentage_amount);
+    displayDebugInfo(debugInfo);
+  }
+
+  return computePicturePercentages(ctx, path, NULL, 0, opts, frame_percentages, percentage_amount, out);
+}
+
+/// @brief determine the RGBA average colors of the frames of several percentages of a picture stored in memory, decoding it only once
+/// @param ctx context created by colorflow_ctx_create
+/// @param data picture stored in memory, read where it is
+/// @param size size of the picture in bytes
+/// @param opts options of the computation, its frame_percentage is not used
+/// @param frame_percentages percentages of the border, each in ]0, 1]
+/// @param percentage_amount number of percentages
+/// @param out array of percentage_amount results we want to store the dimensions and the average RGBA colors into
+/// @return COLORFLOW_OK or an error code
+int colorflow_compute_percentages_memory(colorflow_ctx *ctx, const void *data, size_t size, const colorflow_options *opts, const float *frame_percentages, int percentage_amount, colorflow_result *out){
+
+  if(opts->debug_mode){
+    char debugInfo[300];
+    sprintf(debugInfo, "int colorflow_compute_percentages_memory(colorflow_ctx *ctx, const void *data, size_t size = %zu, const colorflow_options *opts, const float *frame_percentages, int percentage_amount = %d, colorflow_result *out)",size,percentage_amount);
+    displayDebugInfo(debugInfo);
+  }
+
+  return computePicturePercentages(ctx, NULL, data, size, opts, frame_percentages, percentage_amount, out);
+}
+
+/// @brief determine the RGBA average colors of the zones of the frame of a picture stored in a file or in memory in a single pass, and the one of the whole frame
+/// @param ctx context created by colorflow_ctx_create
+/// @param path path of the picture, NULL for a picture stored in memory
+/// @param data picture stored in memory
+/// @param size size of the picture stored in memory
+/// @param opts options of the computation
+/// @param top_amount number of zones of the upper and lower borders
+/// @param side_amount number of zones of the left and right borders
+/// @param zone_RGBA array of 4*(2*top_amount + 2*side_amount) values, filled clockwise from the top left corner
+/// @param out result we want to store the dimensions and the average RGBA color of the whole frame into
+/// @return COLORFLOW_OK or an error code
+static int computePictureZones(colorflow_ctx *ctx, const char *path, const void *data, size_t size, const colorflow_options *opts, int top_amount, int side_amount, int *zone_RGBA, colorflow_result *out){
+
+  ctx->options = *opts;
+
+  if(opts->frame_percentage > 1.0 || opts->frame_percentage <= 0.0){
+    return COLORFLOW_ERROR_BAD_PERCENTAGE;
+  }
+  if(top_amount <= 0 || side_amount <= 0){
+    return COLORFLOW_ERROR_BAD_ZONES;
+  }
+
+  int code;
+  unsigned char buffer[8];
+  FILE *file = open_picture(ctx, path, data, size, buffer, &code);
+  if(code != COLORFLOW_OK){
+    return code;
+  }
+
+  zone_accumulator zones;
+  zones.top_amount = top_amount;
+  zones.side_amount = side_amount;
+  ctx->zones = &zones;
+  code = getFrameColor(ctx, file, buffer, out->average_RGBA);
+  ctx->zones = NULL;
+
+  close_picture(ctx, file);
+
+  if(code == COLORFLOW_OK){
+    computeZoneColors(ctx, &zones, zone_RGBA);
+    profileLap(ctx, COLORFLOW_STAGE_ACCUMULATE, 0);
+  }
+  out->width = ctx->width;
+  out->height = ctx->height;
+  memcpy(out->standard_error, ctx->standard_error, sizeof(out->standard_error));
+  return code;
+}
+
+/// @brief determine the RGBA average colors of the zones of the frame of a picture in a single pass, and the one of the whole frame
+/// @param ctx context created by colorflow_ctx_create
+/// @param path path of the picture
+/// @param opts options of the computation
+/// @param top_amount number of zones of the upper and lower borders
+/// @param side_amount number of zones of the left and right borders
+/// @param zone_RGBA array of 4*(2*top_amount + 2*side_amount) values, filled clockwise from the top left corner
+/// @param out result we want to store the dimensions and the average RGBA color of the whole frame into
+/// @return COLORFLOW_OK or an error code
+int colorflow_compute_zones(colorflow_ctx *ctx, const char *path, const colorflow_options *opts, int top_amount, int side_amount, int *zone_RGBA, colorflow_result *out){
+
+  if(opts->debug_mode){
+    char debugInfo[200];
+    sprintf(debugInfo, "int colorflow_compute_zones(colorflow_ctx *ctx, const char *path, const colorflow_options *opts, int top_amount = %d, int side_amount = %d, int *zone_RGBA, colorflow_result *out)",top_amount,side_amount);
+    displayDebugInfo(debugInfo);
+  }
+
+  return computePictureZones(ctx, path, NULL, 0, opts, top_amount, side_amount, zone_RGBA, out);
+}
+
+/// @brief determine the RGBA average colors of the zones of the frame of a picture stored in memory in a single pass, and the one of the whole frame
+/// @param ctx context created by colorflow_ctx_create
+/// @param data picture stored in memory, read where it is
+/// @param size size of the picture in bytes
+/// @param opts options of the computation
+/// @param top_amount number of zones of the upper and lower borders
+/// @param side_amount number of zones of the left and right borders
+/// @param zone_RGBA array of 4*(2*top_amount + 2*side_amount) values, filled clockwise from the top left corner
+/// @param out result we want to store the dimensions and the average RGBA color of the whole frame into
+/// @return COLORFLOW_OK or an error code
+int colorflow_compute_zones_memory(colorflow_ctx *ctx, const void *data, size_t size, const colorflow_options *opts, int top_amount, int side_amount, int *zone_RGBA, colorflow_result *out){
+
+  if(opts->debug_mode){
+    char debugInfo[300];
+    sprintf(debugInfo, "int colorflow_compute_zones_memory(colorflow_ctx *ctx, const void *data, size_t size = %zu, const colorflow_options *opts, int top_amount = %d, int side_amount = %d, int *zone_RGBA, colorflow_result *out)",size,top_amount,side_amount);
+    displayDebugInfo(debugInfo);
+  }
+
+  return computePictureZones(ctx, NULL, data, size, opts, top_amount, side_amount, zone_RGBA, out);
+}
+
+/// @brief decode a whole picture stored in a file or in memory into the matrix of pixels of the context
+/// @param ctx context created by colorflow_ctx_create
+/// @param path path of the picture, NULL for a picture stored in memory
+/// @param data picture stored in memory
+/// @param size size of the picture stored in memory
+/// @param opts options of the decoding
+/// @return COLORFLOW_OK or an error code
+static int decodePicture(colorflow_ctx *ctx, const char *path, const void *data, size_t size, const colorflow_options *opts){
+
+  ctx->options = *opts;
+
+  int code;
+  unsigned char buffer[8];
+  FILE *file = open_picture(ctx, path, data, size, buffer, &code);
+  if(code != COLORFLOW_OK){
+    return code;
+  }
+
+  code = read_data(ctx, file, buffer);
+
+  close_picture(ctx, file);
+  return code;
+}
+
+/// @brief decode a whole picture into the matrix of pixels of the context, a context can be used by only one thread at a time
+/// @param ctx context created by colorflow_ctx_create
+/// @param path path of the picture
+/// @param opts options of the decoding
+/// @return COLORFLOW_OK or an error code
+int colorflow_decode(colorflow_ctx *ctx, const char *path, const colorflow_options *opts){
+
+  if(opts->debug_mode){
+    displayDebugInfo("int colorflow_decode(colorflow_ctx *ctx, const char *path, const colorflow_options *opts)");
+  }
+
+  return decodePicture(ctx, path, NULL, 0, opts);
+}
+
+/// @brief decode a whole picture stored in memory into the matrix of pixels of the context, a context can be used by only one thread at a time
+/// @param ctx context created by colorflow_ctx_create
+/// @param data picture stored in memory, read where it is
+/// @param size size of the picture in bytes
+/// @param opts options of the decoding
+/// @return COLORFLOW_OK or an error code
+int colorflow_decode_memory(colorflow_ctx *ctx, const void *data, size_t size, const colorflow_options *opts){
+
+  if(opts->debug_mode){
+    displayDebugInfo("int colorflow_decode_memory(colorflow_ctx *ctx, const void *data, size_t size, const colorflow_options *opts)");
+  }
+
+  return decodePicture(ctx, NULL, data, size, opts);
+}
+
+/// @brief read a line of a Y4M stream
+/// @param file Y4M stream
+/// @param line buffer we want to store the line into, without its newline
+/// @param capacity number of characters allowed for line, the end of a longer line is dropped
+/// @return 0, or EOF if the stream ends before the line
+static int read_y4m_line(FILE *file, char *line, size_t capacity){
+  size_t length = 0;
+  int c;
+  while((c = getc(file)) != '\n'){
+    if(c == EOF){
+      return EOF;
+    }
+    if(length + 1 < capacity){
+      line[length++] = c;
+    }
+  }
+  line[length] = '\0';
+  return 0;
+}
+
+/// @brief read the header of a Y4M stream, only the dimensions and the chroma subsampling are used
+/// @param stream stream whose file is set
+/// @return COLORFLOW_OK or an error code
+static int read_y4m_header(colorflow_stream *stream){
+  char line[256];
+  if(read_y4m_line(stream->file, line, sizeof(line)) || strncmp(line, "YUV4MPEG2 ", 10)){
+    return COLORFLOW_ERROR_BAD_FILE;
+  }
+
+  // 4:2:0 is the default subsampling
+  char *colorspace = "420";
+  char *saveptr;
+  for(char *parameter = strtok_r(line + 10, " ", &saveptr); parameter; parameter = strtok_r(NULL, " ", &saveptr)){
+    if(parameter[0] == 'W'){
+      stream->width = atoi(parameter + 1);
+    }
+    else if(parameter[0] == 'H'){
+      stream->height = atoi(parameter + 1);
+    }
+    else if(parameter[0] == 'C'){
+      colorspace = parameter + 1;
+    }
+  }
+
+  stream->chroma = 1;
+  if(!strcmp(colorspace, "420") || !strcmp(colorspace, "420jpeg") || !strcmp(colorspace, "420paldv") || !strcmp(colorspace, "420mpeg2")){
+    stream->chroma_x_shift = 1;
+    stream->chroma_y_shift = 1;
+  }
+  else if(!strcmp(colorspace, "422")){
+    stream->chroma_x_shift = 1;
+    stream->chroma_y_shift = 0;
+  }
+  else if(!strcmp(colorspace, "444")){
+    stream->chroma_x_shift = 0;
+    stream->chroma_y_shift = 0;
+  }
+  else if(!strcmp(colorspace, "mono")){
+    stream->chroma = 0;
+  }
+  else{
+    // Samples of more than 8 bits and alpha planes are not supported
+    return COLORFLOW_ERROR_UNSUPPORTED_FILE_FORMAT;
+  }
+  return COLORFLOW_OK;
+}
+
+/// @brief start reading a video stream, its frame buffer is allowed once for every frame
+/// @param stream stream to initialize
+/// @param file video stream, for instance the standard input
+/// @param format COLORFLOW_STREAM_RGBA or COLORFLOW_STREAM_Y4M
+/// @param width width of the frames of a raw RGBA stream
+/// @param height height of the frames of a raw RGBA stream
+/// @return COLORFLOW_OK or an error code
+int colorflow_stream_open(colorflow_stream *stream, FILE *file, int format, int width, int height){
+  stream->file = file;
+  stream->format = format;
+  stream->width = width;
+  stream->height = height;
+  stream->chroma = 0;
+  stream->chroma_x_shift = 0;
+  stream->chroma_y_shift = 0;
+  stream->frame = NULL;
+
+  if(format == COLORFLOW_STREAM_Y4M){
+    int code = read_y4m_header(stream);
+    if(code != COLORFLOW_OK){
+      return code;
+    }
+  }
+  else if(format != COLORFLOW_STREAM_RGBA){
+    return COLORFLOW_ERROR_UNSUPPORTED_FILE_FORMAT;
+  }
+  if(stream->width <= 0 || stream->height <= 0){
+    return COLORFLOW_ERROR_BAD_FILE;
+  }
+
+  size_t pixel_amount = (size_t)stream->width*stream->height;
+  if(format == COLORFLOW_STREAM_RGBA){
+    stream->frame_size = pixel_amount*sizeof(pixel);
+  }
+  else{
+    size_t chroma_width = ((size_t)stream->width + (1 << stream->chroma_x_shift) - 1) >> stream->chroma_x_shift;
+    size_t chroma_height = ((size_t)stream->height + (1 << stream->chroma_y_shift) - 1) >> stream->chroma_y_shift;
+    stream->frame_size = pixel_amount + (stream->chroma ? 2*chroma_width*chroma_height : 0);
+  }
+
+  stream->frame = (unsigned char*)malloc(stream->frame_size);
+  if(!stream->frame){
+    return COLORFLOW_ERROR_MALLOC;
+  }
+  return COLORFLOW_OK;
+}
+
+/// @brief read the next frame of a video stream into its frame buffer
+/// @param stream stream opened by colorflow_stream_open
+/// @return COLORFLOW_OK, COLORFLOW_END_OF_STREAM or COLORFLOW_ERROR_BAD_FILE
+int colorflow_stream_read(colorflow_stream *stream){
+  if(stream->format == COLORFLOW_STREAM_Y4M){
+    // Every frame starts with a FRAME line, which may have parameters
+    char line[256];
+    if(read_y4m_line(stream->file, line, sizeof(line))){
+      return feof(stream->file) && !ferror(stream->file) ? COLORFLOW_END_OF_STREAM : COLORFLOW_ERROR_BAD_FILE;
+    }
+    if(strncmp(line, "FRAME", 5)){
+      return COLORFLOW_ERROR_BAD_FILE;
+    }
+  }
+
+  size_t n = fread(stream->frame, 1, stream->frame_size, stream->file);
+  if(n == 0 && stream->format == COLORFLOW_STREAM_RGBA && feof(stream->file) && !ferror(stream->file)){
+    return COLORFLOW_END_OF_STREAM;
+  }
+  if(n != stream->frame_size){
+    return COLORFLOW_ERROR_BAD_FILE;
+  }
+  return COLORFLOW_OK;
+}
+
+/// @brief clamp a value into [0, 255]
+static unsigned char clampComponent(int value){
+  return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+/// @brief convert a span of a row of a Y4M frame into RGBA pixels, with the BT.601 studio swing equations
+/// @param stream stream whose last frame is converted
+/// @param y index of the row in the frame
+/// @param row row of pixels we want to store the RGBA values into
+/// @param start_column specifies on which column the span starts
+/// @param end_column specifies on which column the span ends
+static void read_y4m_row(colorflow_stream *stream, int y, pixel *row, int start_column, int end_column){
+  size_t chroma_width = ((size_t)stream->width + (1 << stream->chroma_x_shift) - 1) >> stream->chroma_x_shift;
+  size_t chroma_height = ((size_t)stream->height + (1 << stream->chroma_y_shift) - 1) >> stream->chroma_y_shift;
+  unsigned char *luma = stream->frame + (size_t)y*stream->width;
+  unsigned char *u = stream->frame + (size_t)stream->width*stream->height + (y >> stream->chroma_y_shift)*chroma_width;
+  unsigned char *v = u + chroma_width*chroma_height;
+
+  for(int x=start_column; x<end_column; x++){
+    int c = 298*(luma[x] - 16) + 128;
+    int d = 0, e = 0;
+    if(stream->chroma){
+      d = u[x >> stream->chroma_x_shift] - 128;
+      e = v[x >> stream->chroma_x_shift] - 128;
+    }
+    row[x] = createPixel(
+      clampComponent((c + 409*e) >> 8),
+      clampComponent((c - 100*d - 208*e) >> 8),
+      clampComponent((c + 516*d) >> 8),
+      255);
+  }
+}
+
+/// @brief determine the RGBA average color of the frame of the last frame read from a video stream, and the colors of its zones
+/// @param ctx context created by colorflow_ctx_create, its buffers are allowed by the first frame only
+/// @param stream stream whose frame has been read by colorflow_stream_read
+/// @param opts options of the computation
+/// @param top_amount number of zones of the upper and lower borders, 0 without zones
+/// @param side_amount number of zones of the left and right borders
+/// @param zone_RGBA array of 4*(2*top_amount + 2*side_amount) values, filled clockwise from the top left corner
+/// @param out result we want to store the dimensions and the average RGBA color into
+/// @return COLORFLOW_OK or an error code
+int colorflow_stream_compute(colorflow_ctx *ctx, colorflow_stream *stream, const colorflow_options *opts, int top_amount, int side_amount, int *zone_RGBA, colorflow_result *out){
+
+  ctx->options = *opts;
+
+  if(ctx->options.debug_mode){
+    displayDebugInfo("int colorflow_stream_compute(colorflow_ctx *ctx, colorflow_stream *stream, const colorflow_options *opts, int top_amount, int side_amount, int *zone_RGBA, colorflow_result *out)");
+  }
+
+  if(opts->frame_percentage > 1.0 || opts->frame_percentage <= 0.0){
+    return COLORFLOW_ERROR_BAD_PERCENTAGE;
+  }
+
+  int width = ctx->width = out->width = stream->width;
+  int height = ctx->height = out->height = stream->height;
+
+  zone_accumulator zones;
+  zones.top_amount = top_amount;
+  zones.side_amount = side_amount;
+  ctx->zones = top_amount ? &zones : NULL;
+
+  border_accumulator accumulator;
+  int code = startFrame(ctx, &accumulator);
+  ctx->zones = NULL;
+  if(code == COLORFLOW_OK && stream->format == COLORFLOW_STREAM_Y4M){
+    code = allocateRow(ctx);
+  }
+  if(code != COLORFLOW_OK){
+    return code;
+  }
+
+  for(int y=nextSampledRow(&accumulator, 0); y<height; y=nextSampledRow(&accumulator, y+1)){
+    if(stream->format == COLORFLOW_STREAM_RGBA){
+      // The frame already has the layout of the rows of pixels
+      accumulateRow(&accumulator, y, (pixel*)stream->frame + (size_t)y*width);
+      continue;
+    }
+    if(y < accumulator.up_end || y >= accumulator.down_start){
+      read_y4m_row(stream, y, ctx->row, 0, width);
+    }
+    else{
+      // Only the left and right spans of the middle rows are converted
+      read_y4m_row(stream, y, ctx->row, 0, accumulator.left_end);
+      read_y4m_row(stream, y, ctx->row, accumulator.right_start, width);
+    }
+    accumulateRow(&accumulator, y, ctx->row);
+  }
+
+  finishFrame(ctx, &accumulator, out->average_RGBA);
+  memcpy(out->standard_error, ctx->standard_error, sizeof(out->standard_error));
+  if(top_amount){
+    computeZoneColors(ctx, &zones, zone_RGBA);
+  }
+  return COLORFLOW_OK;
+}
+
+/// @brief free the frame buffer of a video stream, its file is not closed
+/// @param stream stream opened by colorflow_stream_open
+void colorflow_stream_close(colorflow_stream *stream){
+  free(stream->frame);
+  stream->frame = NULL;
+}
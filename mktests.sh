@@ -28,4 +28,339 @@ for IMAGE_FILE in $IMAGES_DIRECTORY/*.bmp $IMAGES_DIRECTORY/*.jpeg $IMAGES_DIREC
         let "EXECUTED_TESTS+=1"
     fi
 done
+
+# Every picture again in a single run, the names are read from the standard input
+BATCH_EXPECTED=""
+for IMAGE_FILE in $IMAGES_DIRECTORY/*.bmp $IMAGES_DIRECTORY/*.jpeg $IMAGES_DIRECTORY/*.png; do
+    BATCH_EXPECTED="$BATCH_EXPECTED$(cat $IMAGE_FILE.result) $IMAGE_FILE"$'\n'
+done
+for THREADS in 1 4; do
+    BATCH_RESULT=$(printf "%s\n" $IMAGES_DIRECTORY/*.bmp $IMAGES_DIRECTORY/*.jpeg $IMAGES_DIRECTORY/*.png | ./colorflow -j $THREADS -@ -)
+    if [ "$BATCH_RESULT"$'\n' = "$BATCH_EXPECTED" ]; then
+        echo "Test batch -j $THREADS ok"
+        let "PASSED_TESTS+=1"
+    else
+        echo "Test batch -j $THREADS failed"
+    fi
+    let "EXECUTED_TESTS+=1"
+done
+
+# Every picture piped into the standard input, decoded from memory
+for IMAGE_FILE in $IMAGES_DIRECTORY/*.bmp $IMAGES_DIRECTORY/*.jpeg $IMAGES_DIRECTORY/*.png; do
+    STDIN_RESULT=$(cat $IMAGE_FILE | ./colorflow -f -)
+    if [ "$STDIN_RESULT" = "$(cat $IMAGE_FILE.result)" ]; then
+        echo "Test stdin $IMAGE_FILE ok"
+        let "PASSED_TESTS+=1"
+    else
+        echo "Test stdin $IMAGE_FILE failed"
+        echo "Got: $STDIN_RESULT"
+    fi
+    let "EXECUTED_TESTS+=1"
+done
+
+# Several frame percentages in one decode, each line must match a run with this percentage alone
+for IMAGE_FILE in $IMAGES_DIRECTORY/*.bmp $IMAGES_DIRECTORY/*.jpeg $IMAGES_DIRECTORY/*.png; do
+    PERCENTAGES_EXPECTED=""
+    for PERCENTAGE in 1 5 10 20 50 100; do
+        PERCENTAGES_EXPECTED="$PERCENTAGES_EXPECTED$(./colorflow -n $PERCENTAGE $IMAGE_FILE) $PERCENTAGE"$'\n'
+    done
+    PERCENTAGES_RESULT=$(./colorflow -n 1,5,10,20,50,100 $IMAGE_FILE)
+    if [ "$PERCENTAGES_RESULT"$'\n' = "$PERCENTAGES_EXPECTED" ]; then
+        echo "Test percentages $IMAGE_FILE ok"
+        let "PASSED_TESTS+=1"
+    else
+        echo "Test percentages $IMAGE_FILE failed"
+        echo "-----------------------------------------------"
+        echo "Expected: $PERCENTAGES_EXPECTED"
+        echo "Got: $PERCENTAGES_RESULT"
+        echo "-----------------------------------------------"
+    fi
+    let "EXECUTED_TESTS+=1"
+done
+
+# Zones of plain pictures all have the color of the frame
+for IMAGE_FILE in $IMAGES_DIRECTORY/{black,blue,green,red,white}.{bmp,jpeg,png}; do
+    COLOR="$(cat $IMAGE_FILE.result)"
+    ZONES_EXPECTED="$COLOR $COLOR $COLOR $COLOR $COLOR $COLOR $COLOR $COLOR $COLOR $COLOR"
+    ZONES_RESULT=$(./colorflow --zones 3x2 $IMAGE_FILE)
+    if [ "$ZONES_RESULT" = "$ZONES_EXPECTED" ]; then
+        echo "Test zones $IMAGE_FILE ok"
+        let "PASSED_TESTS+=1"
+    else
+        echo "Test zones $IMAGE_FILE failed"
+        echo "Got: $ZONES_RESULT"
+    fi
+    let "EXECUTED_TESTS+=1"
+done
+
+# Video streams read from the standard input, one color per frame
+# The bytes of the frames stay escaped until the last printf
+Y4M_FRAME_WHITE="FRAME\n$(printf '\\xeb%.0s' {1..16})$(printf '\\x80%.0s' {1..8})"
+Y4M_FRAME_BLACK="FRAME\n$(printf '\\x10%.0s' {1..16})$(printf '\\x80%.0s' {1..8})"
+STREAM_RESULT=$(printf "YUV4MPEG2 W4 H4 F25:1 Ip A1:1 C420jpeg\n$Y4M_FRAME_WHITE$Y4M_FRAME_BLACK$Y4M_FRAME_WHITE" | ./colorflow --y4m -n 50 2> /dev/null)
+if [ "$STREAM_RESULT" = $'FFFFFF-FF\n000000-FF\nFFFFFF-FF' ]; then
+    echo "Test y4m stream ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test y4m stream failed"
+    echo "Got: $STREAM_RESULT"
+fi
+let "EXECUTED_TESTS+=1"
+STREAM_RESULT=$(printf '\x00\x00\xff\xff%.0s' {1..24} | ./colorflow --rgba 3x4 -n 50 2> /dev/null)
+if [ "$STREAM_RESULT" = $'0000FF-FF\n0000FF-FF' ]; then
+    echo "Test rgba stream ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test rgba stream failed"
+    echo "Got: $STREAM_RESULT"
+fi
+let "EXECUTED_TESTS+=1"
+STREAM_RESULT=$(printf '\x00\x00\xff\xff%.0s' {1..200} | ./colorflow --rgba 10x10 -n 50 --sample 2 2> /dev/null)
+if [ "$STREAM_RESULT" = $'0000FF-FF se 0.00,0.00,0.00,0.00\n0000FF-FF se 0.00,0.00,0.00,0.00' ]; then
+    echo "Test sampled stream ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test sampled stream failed"
+    echo "Got: $STREAM_RESULT"
+fi
+let "EXECUTED_TESTS+=1"
+
+# Approximations of the JPEG pictures, their frames are uniform enough to give the exact colors
+for FAST_JPEG in scaled dc; do
+    for IMAGE_FILE in $IMAGES_DIRECTORY/*.jpeg; do
+        FAST_RESULT=$(./colorflow --fast-jpeg=$FAST_JPEG $IMAGE_FILE)
+        if [ "$FAST_RESULT" = "$(cat $IMAGE_FILE.result)" ]; then
+            echo "Test fast jpeg $FAST_JPEG $IMAGE_FILE ok"
+            let "PASSED_TESTS+=1"
+        else
+            echo "Test fast jpeg $FAST_JPEG $IMAGE_FILE failed"
+            echo "Got: $FAST_RESULT"
+        fi
+        let "EXECUTED_TESTS+=1"
+    done
+done
+
+# Result cache, the second run reads every color from the cache and gives the same colors
+CACHE_FILE=$(mktemp -u)
+CACHE_EXPECTED=$(./colorflow -n 5,10 $IMAGES_DIRECTORY/*.bmp $IMAGES_DIRECTORY/*.jpeg $IMAGES_DIRECTORY/*.png)
+./colorflow --cache $CACHE_FILE -n 5,10 $IMAGES_DIRECTORY/*.bmp $IMAGES_DIRECTORY/*.jpeg $IMAGES_DIRECTORY/*.png > /dev/null 2>&1
+CACHE_RESULT=$(./colorflow --cache $CACHE_FILE -j 4 -n 5,10 $IMAGES_DIRECTORY/*.bmp $IMAGES_DIRECTORY/*.jpeg $IMAGES_DIRECTORY/*.png 2> $CACHE_FILE.stats)
+if [ "$CACHE_RESULT" = "$CACHE_EXPECTED" ] && grep -q " 0 cache misses" $CACHE_FILE.stats; then
+    echo "Test cache ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test cache failed"
+    cat $CACHE_FILE.stats
+fi
+let "EXECUTED_TESTS+=1"
+rm -f $CACHE_FILE $CACHE_FILE.stats
+
+# A modified file is a miss, and each of its versions replaces the entry of the previous one
+CACHE_FILE=$(mktemp -u)
+CACHE_PICTURE=$(mktemp)
+cp $IMAGES_DIRECTORY/road.png $CACHE_PICTURE
+CACHE_FAILED=0
+for VERSION in 1 2 3 4 5 6 7 8 9 10; do
+    touch -d "2020-01-01 00:00:$VERSION" $CACHE_PICTURE
+    ./colorflow --cache $CACHE_FILE -n 10 $CACHE_PICTURE 2>&1 > /dev/null | grep -q "0 cache hits, 1 cache misses" || CACHE_FAILED=1
+done
+./colorflow --cache $CACHE_FILE -n 10 $CACHE_PICTURE 2>&1 > /dev/null | grep -q "1 cache hits, 0 cache misses" || CACHE_FAILED=1
+# Entries of 64 bytes after a header of 64 bytes, the last 8 bytes of a taken entry are not 0
+CACHE_ENTRIES=$(od -An -v -tx8 -w64 -j 64 $CACHE_FILE | awk '$8 != "0000000000000000"' | wc -l)
+if [ $CACHE_FAILED = 0 ] && [ $CACHE_ENTRIES = 1 ]; then
+    echo "Test cache modified file ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test cache modified file failed"
+    echo "Entries: $CACHE_ENTRIES"
+fi
+let "EXECUTED_TESTS+=1"
+rm -f $CACHE_FILE $CACHE_PICTURE
+
+# Identical files, the copies take the colors of the first one without being decoded
+DEDUP_DIR=$(mktemp -d)
+cp $IMAGES_DIRECTORY/road.png $DEDUP_DIR/a.png
+cp $IMAGES_DIRECTORY/red.png $DEDUP_DIR/b.png
+cp $IMAGES_DIRECTORY/road.png $DEDUP_DIR/c.png
+cp $IMAGES_DIRECTORY/road.png $DEDUP_DIR/d.png
+DEDUP_EXPECTED=$(./colorflow -n 5,10 $DEDUP_DIR/*.png)
+DEDUP_RESULT=$(./colorflow --dedup -j 2 -n 5,10 $DEDUP_DIR/*.png 2> $DEDUP_DIR/stats)
+if [ "$DEDUP_RESULT" = "$DEDUP_EXPECTED" ] && grep -q "4 files, 2 decodes saved" $DEDUP_DIR/stats; then
+    echo "Test dedup ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test dedup failed"
+    cat $DEDUP_DIR/stats
+fi
+let "EXECUTED_TESTS+=1"
+
+# In any order, every file with the same content gets its own line
+DEDUP_UNORDERED=$(./colorflow --dedup --unordered -j 2 -n 5,10 $DEDUP_DIR/*.png 2> /dev/null)
+if [ "$(echo "$DEDUP_UNORDERED" | wc -l)" = "$(echo "$DEDUP_EXPECTED" | wc -l)" ] && [ "$(echo "$DEDUP_UNORDERED" | sort)" = "$(echo "$DEDUP_EXPECTED" | sort)" ]; then
+    echo "Test dedup unordered ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test dedup unordered failed"
+    echo "$DEDUP_UNORDERED"
+fi
+let "EXECUTED_TESTS+=1"
+rm -rf $DEDUP_DIR
+
+# Stage times, the colors are the same as without --profile and every file gets a line of stages on the error output
+PROFILE_STATS=$(mktemp)
+PROFILE_EXPECTED=$(./colorflow -n 5,10 $IMAGES_DIRECTORY/road.png $IMAGES_DIRECTORY/red.bmp $IMAGES_DIRECTORY/mountain.jpeg)
+PROFILE_RESULT=$(./colorflow --profile -j 2 -n 5,10 $IMAGES_DIRECTORY/road.png $IMAGES_DIRECTORY/red.bmp $IMAGES_DIRECTORY/mountain.jpeg 2> $PROFILE_STATS)
+PROFILE_JSON=$(./colorflow --profile=json -n 5,10 $IMAGES_DIRECTORY/road.png $IMAGES_DIRECTORY/red.bmp 2>&1 >/dev/null)
+if [ "$PROFILE_RESULT" = "$PROFILE_EXPECTED" ] && [ $(grep -c "scanlines .* accumulate .* total" $PROFILE_STATS) = 3 ] && grep -q "3 files profiled" $PROFILE_STATS && [ $(echo "$PROFILE_JSON" | grep -c '^{"file":.*"total_ns":[0-9]*}$') = 2 ] && echo "$PROFILE_JSON" | grep -q '^{"summary":{"files":2,'; then
+    echo "Test profile ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test profile failed"
+    cat $PROFILE_STATS
+    echo "$PROFILE_JSON"
+fi
+let "EXECUTED_TESTS+=1"
+rm -f $PROFILE_STATS
+
+# Trace of a run on two threads, the colors are the same as without --trace and every decoded file has its spans
+TRACE_FILE=$(mktemp)
+TRACE_RESULT=$(./colorflow --trace $TRACE_FILE -j 2 -n 5,10 $IMAGES_DIRECTORY/road.png $IMAGES_DIRECTORY/red.bmp $IMAGES_DIRECTORY/mountain.jpeg)
+if [ "$TRACE_RESULT" = "$PROFILE_EXPECTED" ] && grep -q '^{"displayTimeUnit":"ms","traceEvents":\[$' $TRACE_FILE && [ $(grep -c '"name":"decode".*"width":6000,"height":4000' $TRACE_FILE) = 1 ] && [ $(grep -c '"name":"compute"' $TRACE_FILE) = 3 ] && [ $(grep -c '"name":"output"' $TRACE_FILE) = 3 ] && [ $(grep -c '"thread_name"' $TRACE_FILE) = 2 ] && tail -n 1 $TRACE_FILE | grep -q '^]}$'; then
+    echo "Test trace ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test trace failed"
+    cat $TRACE_FILE
+fi
+let "EXECUTED_TESTS+=1"
+rm -f $TRACE_FILE
+
+# Sampling, a stride of 1 is the exact color, a larger one stays close to it with its standard error, and it needs a single percentage
+SAMPLE_FILES="$IMAGES_DIRECTORY/road.png $IMAGES_DIRECTORY/mountain.jpeg $IMAGES_DIRECTORY/red.bmp"
+SAMPLE_EXPECTED=$(./colorflow -n 10 $SAMPLE_FILES)
+SAMPLE_EXACT=$(./colorflow --sample 1 -n 10 $SAMPLE_FILES)
+SAMPLE_RESULT=$(./colorflow --sample 4 -n 10 $SAMPLE_FILES)
+SAMPLE_FAILED=0
+[ "$SAMPLE_EXACT" = "$SAMPLE_EXPECTED" ] || SAMPLE_FAILED=1
+[ $(echo "$SAMPLE_RESULT" | grep -c '^[0-9A-F]\{6\}-[0-9A-F]\{2\} se [0-9.]*,[0-9.]*,[0-9.]*,[0-9.]* ') = 3 ] || SAMPLE_FAILED=1
+# Every channel of the sampled colors is within 2 of the exact one
+paste -d ' ' <(echo "$SAMPLE_EXPECTED" | cut -c1-9) <(echo "$SAMPLE_RESULT" | cut -c1-9) | while read EXACT SAMPLED; do
+    for i in 0 2 4 7; do
+        DIFFERENCE=$(( 0x${EXACT:$i:2} - 0x${SAMPLED:$i:2} ))
+        [ ${DIFFERENCE#-} -le 2 ] || exit 1
+    done
+done || SAMPLE_FAILED=1
+./colorflow --sample 4 -n 5,10 $IMAGES_DIRECTORY/road.png > /dev/null 2>&1 && SAMPLE_FAILED=1
+./colorflow --sample 4 --serve $(mktemp -u) > /dev/null 2>&1 && SAMPLE_FAILED=1
+if [ $SAMPLE_FAILED = 0 ]; then
+    echo "Test sample ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test sample failed"
+    echo "$SAMPLE_EXPECTED"
+    echo "$SAMPLE_RESULT"
+fi
+let "EXECUTED_TESTS+=1"
+
+# Server on a UNIX domain socket, several clients at once get the colors of colorflow without server
+SERVER_SOCKET=$(mktemp -u)
+./colorflow --serve $SERVER_SOCKET -j 4 &
+SERVER_PID=$!
+for i in $(seq 50); do
+    [ -S $SERVER_SOCKET ] && break
+    sleep 0.1
+done
+SERVER_EXPECTED=$(./colorflow -n 5,10 $IMAGES_DIRECTORY/*.bmp $IMAGES_DIRECTORY/*.jpeg $IMAGES_DIRECTORY/*.png 2>&1)
+SERVER_FAILED=0
+CLIENT_PIDS=""
+for i in 1 2 3 4; do
+    ./colorflow --client $SERVER_SOCKET -n 5,10 $IMAGES_DIRECTORY/*.bmp $IMAGES_DIRECTORY/*.jpeg $IMAGES_DIRECTORY/*.png > $SERVER_SOCKET.$i 2>&1 &
+    CLIENT_PIDS="$CLIENT_PIDS $!"
+done
+wait $CLIENT_PIDS
+for i in 1 2 3 4; do
+    [ "$(cat $SERVER_SOCKET.$i)" = "$SERVER_EXPECTED" ] || SERVER_FAILED=1
+done
+kill $SERVER_PID
+wait $SERVER_PID
+if [ $SERVER_FAILED = 0 ] && [ ! -e $SERVER_SOCKET ]; then
+    echo "Test server ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test server failed"
+fi
+let "EXECUTED_TESTS+=1"
+rm -f $SERVER_SOCKET $SERVER_SOCKET.*
+
+# Black BMP picture bigger than the 48 MB the decoded BMP pictures were limited to
+BIG_BMP=$(mktemp)
+printf 'BM\x36\x6c\xdc\x02\0\0\0\0\x36\0\0\0\x28\0\0\0\xa0\x0f\0\0\xa0\x0f\0\0\x01\0\x18\0\0\0\0\0\0\x6c\xdc\x02\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0' > $BIG_BMP
+head -c 48000000 /dev/zero >> $BIG_BMP
+BIG_RESULT=$(./colorflow $BIG_BMP)
+if [ "$BIG_RESULT" = "000000-FF" ]; then
+    echo "Test big bmp ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test big bmp failed"
+    echo "Got: $BIG_RESULT"
+fi
+let "EXECUTED_TESTS+=1"
+rm -f $BIG_BMP
+
+# RLE BMP pictures cut in the middle of their data, or moving the cursor out of the picture, are bad files
+RLE_BAD=$(mktemp)
+head -c 97 $IMAGES_DIRECTORY/rle8.bmp > $RLE_BAD
+./colorflow $RLE_BAD > /dev/null 2>&1
+RLE_TRUNCATED=$?
+# The delta escape at byte 90 moves the cursor 200 pixels to the right
+cp $IMAGES_DIRECTORY/rle8.bmp $RLE_BAD
+printf '\xc8' | dd of=$RLE_BAD bs=1 seek=92 conv=notrunc status=none
+./colorflow $RLE_BAD > /dev/null 2>&1
+RLE_DELTA=$?
+if [ $RLE_TRUNCATED = 2 ] && [ $RLE_DELTA = 2 ]; then
+    echo "Test bad rle bmp ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test bad rle bmp failed"
+    echo "Got: $RLE_TRUNCATED $RLE_DELTA"
+fi
+let "EXECUTED_TESTS+=1"
+rm -f $RLE_BAD
+
+# A kernel that does not exist is refused with a warning, and the fastest supported kernel gives the usual color
+KERNEL_RESULT=$(COLORFLOW_KERNEL=bogus ./colorflow $IMAGES_DIRECTORY/road.png 2> /dev/null)
+KERNEL_WARNING=$(COLORFLOW_KERNEL=bogus ./colorflow $IMAGES_DIRECTORY/road.png 2>&1 > /dev/null)
+if [ "$KERNEL_RESULT" = "$(cat $IMAGES_DIRECTORY/road.png.result)" ] && echo "$KERNEL_WARNING" | grep -q "^Warning: COLORFLOW_KERNEL=bogus is not a kernel supported by this processor, [a-z0-9]* is used$"; then
+    echo "Test unknown kernel ok"
+    let "PASSED_TESTS+=1"
+else
+    echo "Test unknown kernel failed"
+    echo "Got: $KERNEL_RESULT $KERNEL_WARNING"
+fi
+let "EXECUTED_TESTS+=1"
+
+# Border sums of a synthetic picture too big for 32 bit sums
+if [ -x ./tests/huge_sums ]; then
+    if ./tests/huge_sums > /dev/null; then
+        echo "Test huge sums ok"
+        let "PASSED_TESTS+=1"
+    else
+        echo "Test huge sums failed"
+        ./tests/huge_sums
+    fi
+    let "EXECUTED_TESTS+=1"
+fi
+
+# Pictures decoded whole, every format has rows aligned on 64 bytes and the color of colorflow_compute
+if [ -x ./tests/decoded_rows ]; then
+    if ./tests/decoded_rows $IMAGES_DIRECTORY/*.bmp $IMAGES_DIRECTORY/*.jpeg $IMAGES_DIRECTORY/*.png > /dev/null; then
+        echo "Test decoded rows ok"
+        let "PASSED_TESTS+=1"
+    else
+        echo "Test decoded rows failed"
+        ./tests/decoded_rows $IMAGES_DIRECTORY/*.bmp $IMAGES_DIRECTORY/*.jpeg $IMAGES_DIRECTORY/*.png | grep -v " ok$"
+    fi
+    let "EXECUTED_TESTS+=1"
+fi
+
 echo "Tests: $PASSED_TESTS passed, $EXECUTED_TESTS total"
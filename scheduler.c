@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "include/scheduler.h"
+
+// Jobs of one worker: the owner takes them from the front, the others steal them from the back
+// A worker never receives new jobs, so a mutex per deque is enough and is never contended for long
+typedef struct{
+  pthread_mutex_t lock;
+  int front;
+  int back;           // jobs [front, back) are waiting
+} job_deque;
+
+typedef struct{
+  int thread;
+  int thread_amount;
+  job_deque *deques;
+  scheduler_work work;
+  void *data;
+} worker;
+
+/// @brief take the next job of a worker from the front of its own deque
+/// @param deque deque of the worker
+/// @return index of the job or -1 if the deque is empty
+int popJob(job_deque *deque){
+  int job = -1;
+  pthread_mutex_lock(&deque->lock);
+  if(deque->front < deque->back){
+    job = deque->front++;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return job;
+}
+
+/// @brief take the last job of another worker
+/// @param deque deque of the other worker
+/// @return index of the job or -1 if the deque is empty
+int stealJob(job_deque *deque){
+  int job = -1;
+  pthread_mutex_lock(&deque->lock);
+  if(deque->front < deque->back){
+    job = --deque->back;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return job;
+}
+
+void *runWorker(void *arg){
+  worker *self = (worker*)arg;
+  for(;;){
+    int job = popJob(&self->deques[self->thread]);
+
+    // Own deque is empty: steal from the others, starting with the next worker
+    for(int i = 1; job == -1 && i < self->thread_amount; i++){
+      job = stealJob(&self->deques[(self->thread + i) % self->thread_amount]);
+    }
+    if(job == -1){
+      return NULL;
+    }
+    self->work(self->thread, job, self->data);
+  }
+}
+
+int runJobs(int job_amount, int thread_amount, scheduler_work work, void *data){
+  if(thread_amount > job_amount){
+    thread_amount = job_amount;
+  }
+  if(thread_amount <= 1){
+    for(int job = 0; job < job_amount; job++){
+      work(0, job, data);
+    }
+    return 0;
+  }
+
+  job_deque *deques = (job_deque*)malloc(thread_amount*sizeof(job_deque));
+  worker *workers = (worker*)malloc(thread_amount*sizeof(worker));
+  pthread_t *threads = (pthread_t*)malloc(thread_amount*sizeof(pthread_t));
+  if(!deques || !workers || !threads){
+    free(deques);
+    free(workers);
+    free(threads);
+    return -1;
+  }
+
+  // Every worker starts with a contiguous block of jobs, so the results come roughly in input order
+  for(int i = 0; i < thread_amount; i++){
+    pthread_mutex_init(&deques[i].lock, NULL);
+    deques[i].front = (int)((long)job_amount*i/thread_amount);
+    deques[i].back = (int)((long)job_amount*(i+1)/thread_amount);
+    workers[i].thread = i;
+    workers[i].thread_amount = thread_amount;
+    workers[i].deques = deques;
+    workers[i].work = work;
+    workers[i].data = data;
+  }
+
+  // The calling thread is the worker 0
+  int started = 1;
+  for(int i = 1; i < thread_amount; i++){
+    if(pthread_create(&threads[i], NULL, runWorker, &workers[i])){
+      break;    // the jobs of the missing workers are stolen by the others
+    }
+    started++;
+  }
+  runWorker(&workers[0]);
+  for(int i = 1; i < started; i++){
+    pthread_join(threads[i], NULL);
+  }
+
+  for(int i = 0; i < thread_amount; i++){
+    pthread_mutex_destroy(&deques[i].lock);
+  }
+  free(deques);
+  free(workers);
+  free(threads);
+  return 0;
+}
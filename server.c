@@ -0,0 +1,694 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "include/server.h"
+
+// Requests of a client between the one being read and the oldest answer not yet written, its socket is not read while they are all taken
+#define CLIENT_WINDOW 64
+// Longest request, a client that sends a longer line is disconnected, complete requests waiting for the window do not count
+#define CLIENT_MAX_REQUEST 65536
+// Answers waiting to be written to a client, its socket is not read while there are more
+#define CLIENT_MAX_OUTPUT 65536
+#define SERVER_EVENTS 64
+
+typedef struct server_client{
+  int fd;
+  char *input;
+  size_t input_length;
+  size_t input_capacity;
+  char *output;
+  size_t output_length;
+  size_t output_sent;
+  size_t output_capacity;
+  char *answers[CLIENT_WINDOW];   // computed answers waiting for the previous ones, by sequence number
+  uint64_t next_request;          // sequence number of the next request read
+  uint64_t next_answer;           // sequence number of the next answer written
+  int in_flight;                  // requests held by the workers, a closed client is freed once they are all back
+  int input_ended;
+  int closed;
+  int answered;                   // received answers since the last flush
+  uint32_t events;                // events the socket is registered for
+  struct server_client *previous; // list of the open clients, or of the closed ones
+  struct server_client *next;
+  struct server_client *next_answered;
+} server_client;
+
+// Request of a client, given to a worker then back to the event loop with its answer
+typedef struct server_task{
+  struct server_task *next;
+  server_client *client;
+  uint64_t sequence;
+  char *answer;
+  char request[];
+} server_task;
+
+typedef struct{
+  server_work work;
+  void *data;
+  int epoll_fd;
+  int event_fd;                   // written by the workers when an answer is ready
+  server_client *clients;         // open clients
+  server_client *closed_clients;  // freed after the events being handled, once the workers hold none of their requests
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  server_task *queue_front;       // requests waiting for a worker, oldest first
+  server_task *queue_back;
+  server_task *done;              // answered requests waiting for the event loop
+  int stopping;
+} server_state;
+
+typedef struct{
+  int worker;
+  server_state *state;
+} server_worker;
+
+void *runServerWorker(void *arg){
+  server_worker *self = (server_worker*)arg;
+  server_state *state = self->state;
+  for(;;){
+    pthread_mutex_lock(&state->lock);
+    while(!state->queue_front && !state->stopping){
+      pthread_cond_wait(&state->ready, &state->lock);
+    }
+    if(state->stopping){
+      pthread_mutex_unlock(&state->lock);
+      return NULL;
+    }
+    server_task *task = state->queue_front;
+    state->queue_front = task->next;
+    if(!state->queue_front){
+      state->queue_back = NULL;
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    task->answer = state->work(self->worker, task->request, state->data);
+
+    pthread_mutex_lock(&state->lock);
+    task->next = state->done;
+    state->done = task;
+    pthread_mutex_unlock(&state->lock);
+    uint64_t one = 1;
+    if(write(state->event_fd, &one, sizeof(one)) < 0){
+      // The counter is already set, the event loop will take every answer
+    }
+  }
+}
+
+/// @brief register a client for the events it can handle now
+/// @param state server
+/// @param client open client
+void updateEvents(server_state *state, server_client *client){
+  size_t pending = client->output_length - client->output_sent;
+  uint32_t events = 0;
+  if(!client->input_ended && client->next_request - client->next_answer < CLIENT_WINDOW && pending < CLIENT_MAX_OUTPUT){
+    events |= EPOLLIN;
+  }
+  if(pending > 0){
+    events |= EPOLLOUT;
+  }
+  if(events != client->events){
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = client;
+    epoll_ctl(state->epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+    client->events = events;
+  }
+}
+
+/// @brief free a client
+/// @param client closed client
+void freeClient(server_client *client){
+  for(int i = 0; i < CLIENT_WINDOW; i++){
+    free(client->answers[i]);
+  }
+  free(client->input);
+  free(client->output);
+  free(client);
+}
+
+/// @brief close the connection of a client, its requests still held by the workers are dropped when they come back
+/// @param state server
+/// @param client open client
+void closeClient(server_state *state, server_client *client){
+  epoll_ctl(state->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+  close(client->fd);
+  client->closed = 1;
+  if(client->previous){
+    client->previous->next = client->next;
+  }
+  else{
+    state->clients = client->next;
+  }
+  if(client->next){
+    client->next->previous = client->previous;
+  }
+  client->previous = NULL;
+  client->next = state->closed_clients;
+  if(state->closed_clients){
+    state->closed_clients->previous = client;
+  }
+  state->closed_clients = client;
+}
+
+/// @brief free the closed clients whose requests are all back from the workers
+/// @param state server
+void freeClosedClients(server_state *state){
+  server_client *client = state->closed_clients;
+  while(client){
+    server_client *next = client->next;
+    if(client->in_flight == 0){
+      if(client->previous){
+        client->previous->next = next;
+      }
+      else{
+        state->closed_clients = next;
+      }
+      if(next){
+        next->previous = client->previous;
+      }
+      freeClient(client);
+    }
+    client = next;
+  }
+}
+
+/// @brief close a client once all its requests are answered and it sends no more, or register it for the events it can handle now
+/// @param state server
+/// @param client open client
+void finishEvents(server_state *state, server_client *client){
+  if(client->input_ended && client->next_answer == client->next_request && client->output_length == 0){
+    closeClient(state, client);
+  }
+  else{
+    updateEvents(state, client);
+  }
+}
+
+/// @brief give every complete request of a client to the workers, while its window has room
+/// @param state server
+/// @param client open client
+/// @return 0, or -1 if the client has to be closed
+int queueRequests(server_state *state, server_client *client){
+  size_t start = 0;
+  server_task *front = NULL;
+  server_task *back = NULL;
+  int amount = 0;
+  int failed = 0;
+  while(client->next_request - client->next_answer < CLIENT_WINDOW){
+    char *end = memchr(client->input + start, '\n', client->input_length - start);
+    if(!end){
+      break;
+    }
+    size_t length = end - (client->input + start);
+    // Requests written on Windows end with \r
+    if(length > 0 && client->input[start + length - 1] == '\r'){
+      length--;
+    }
+    server_task *task = (server_task*)malloc(sizeof(server_task) + length + 1);
+    if(!task){
+      failed = 1;
+      break;
+    }
+    memcpy(task->request, client->input + start, length);
+    task->request[length] = '\0';
+    task->client = client;
+    task->sequence = client->next_request++;
+    task->answer = NULL;
+    task->next = NULL;
+    if(back){
+      back->next = task;
+    }
+    else{
+      front = task;
+    }
+    back = task;
+    client->in_flight++;
+    amount++;
+    start = end + 1 - client->input;
+  }
+  memmove(client->input, client->input + start, client->input_length - start);
+  client->input_length -= start;
+
+  if(amount){
+    pthread_mutex_lock(&state->lock);
+    if(state->queue_back){
+      state->queue_back->next = front;
+    }
+    else{
+      state->queue_front = front;
+    }
+    state->queue_back = back;
+    if(amount > 1){
+      pthread_cond_broadcast(&state->ready);
+    }
+    else{
+      pthread_cond_signal(&state->ready);
+    }
+    pthread_mutex_unlock(&state->lock);
+  }
+
+  // Complete requests wait for room in the window, only a line without its end can be too long
+  char *last_end = memrchr(client->input, '\n', client->input_length);
+  size_t unterminated = last_end ? client->input_length - (last_end + 1 - client->input) : client->input_length;
+  return failed || unterminated >= CLIENT_MAX_REQUEST ? -1 : 0;
+}
+
+/// @brief write as much of the answers of a client as its socket takes
+/// @param client open client
+/// @return 0, or -1 if the client has to be closed
+int sendAnswers(server_client *client){
+  while(client->output_sent < client->output_length){
+    ssize_t sent = send(client->fd, client->output + client->output_sent, client->output_length - client->output_sent, MSG_NOSIGNAL);
+    if(sent < 0){
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+    }
+    client->output_sent += sent;
+  }
+  client->output_sent = 0;
+  client->output_length = 0;
+  return 0;
+}
+
+/// @brief move the answers of a client that follow the last written one to its output
+/// @param client open client
+/// @return 0, or -1 if the client has to be closed
+int appendAnswers(server_client *client){
+  char **answer;
+  while(*(answer = &client->answers[client->next_answer % CLIENT_WINDOW])){
+    size_t length = strlen(*answer);
+    if(client->output_length + length + 1 > client->output_capacity){
+      size_t capacity = 2*(client->output_length + length + 1);
+      char *bigger = (char*)realloc(client->output, capacity);
+      if(!bigger){
+        return -1;
+      }
+      client->output = bigger;
+      client->output_capacity = capacity;
+    }
+    memcpy(client->output + client->output_length, *answer, length);
+    client->output[client->output_length + length] = '\n';
+    client->output_length += length + 1;
+    free(*answer);
+    *answer = NULL;
+    client->next_answer++;
+  }
+  return 0;
+}
+
+/// @brief read the requests of a client
+/// @param state server
+/// @param client open client
+/// @return 0, or -1 if the client has to be closed
+int readRequests(server_state *state, server_client *client){
+  if(client->input_capacity - client->input_length < 4096){
+    size_t capacity = client->input_capacity ? 2*client->input_capacity : 8192;
+    char *bigger = (char*)realloc(client->input, capacity);
+    if(!bigger){
+      return -1;
+    }
+    client->input = bigger;
+    client->input_capacity = capacity;
+  }
+  ssize_t received = recv(client->fd, client->input + client->input_length, client->input_capacity - client->input_length, 0);
+  if(received < 0){
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+  }
+  if(received == 0){
+    // The client sent all its requests, it is closed once they are answered
+    client->input_ended = 1;
+    return 0;
+  }
+  client->input_length += received;
+  return queueRequests(state, client);
+}
+
+/// @brief give the answers computed by the workers to their clients
+/// @param state server
+void takeAnswers(server_state *state){
+  uint64_t counter;
+  if(read(state->event_fd, &counter, sizeof(counter)) < 0){
+    // Nothing to read, the answers have been taken with the ones of an earlier event
+  }
+  pthread_mutex_lock(&state->lock);
+  server_task *task = state->done;
+  state->done = NULL;
+  pthread_mutex_unlock(&state->lock);
+
+  server_client *answered = NULL;
+  while(task){
+    server_task *next = task->next;
+    server_client *client = task->client;
+    client->in_flight--;
+    if(client->closed){
+      free(task->answer);
+    }
+    else if(!task->answer){
+      closeClient(state, client);
+    }
+    else{
+      client->answers[task->sequence % CLIENT_WINDOW] = task->answer;
+      if(!client->answered){
+        client->answered = 1;
+        client->next_answered = answered;
+        answered = client;
+      }
+    }
+    free(task);
+    task = next;
+  }
+
+  // Every client that received an answer is flushed
+  for(server_client *client = answered; client; client = client->next_answered){
+    client->answered = 0;
+    if(client->closed){
+      continue;
+    }
+    if(appendAnswers(client) != 0 || sendAnswers(client) != 0 || queueRequests(state, client) != 0){
+      closeClient(state, client);
+    }
+    else{
+      finishEvents(state, client);
+    }
+  }
+}
+
+/// @brief accept every waiting client
+/// @param state server
+/// @param listen_fd listening socket
+void acceptClients(server_state *state, int listen_fd){
+  for(;;){
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if(fd < 0){
+      return;
+    }
+    server_client *client = (server_client*)calloc(1, sizeof(server_client));
+    if(!client){
+      close(fd);
+      continue;
+    }
+    client->fd = fd;
+    client->events = EPOLLIN;
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = client;
+    if(epoll_ctl(state->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0){
+      close(fd);
+      free(client);
+      continue;
+    }
+    client->next = state->clients;
+    if(state->clients){
+      state->clients->previous = client;
+    }
+    state->clients = client;
+  }
+}
+
+/// @brief create the listening socket path, replacing the socket of a server that is gone
+/// @param path path of the socket
+/// @return socket, or -1 with errno set
+int listenSocket(const char *path){
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(strlen(path) >= sizeof(address.sun_path)){
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(address.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if(fd < 0){
+    return -1;
+  }
+  if(bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0){
+    // A socket nobody accepts on is left by a server that is gone
+    struct stat info;
+    if(errno != EADDRINUSE){
+      close(fd);
+      return -1;
+    }
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int alive = probe >= 0 && connect(probe, (struct sockaddr*)&address, sizeof(address)) == 0;
+    if(probe >= 0){
+      close(probe);
+    }
+    if(alive || stat(path, &info) != 0 || !S_ISSOCK(info.st_mode)){
+      close(fd);
+      errno = EADDRINUSE;
+      return -1;
+    }
+    unlink(path);
+    if(bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0){
+      close(fd);
+      return -1;
+    }
+  }
+  if(listen(fd, SOMAXCONN) != 0){
+    close(fd);
+    unlink(path);
+    return -1;
+  }
+  return fd;
+}
+
+/// @brief serve a UNIX domain socket until SIGINT or SIGTERM
+/// @param path path of the socket
+/// @param worker_amount number of workers computing the requests
+/// @param work function computing the answer of a request
+/// @param data data given to work
+/// @return 0 once stopped, or -1 with errno set if the socket could not be served
+int runServer(const char *path, int worker_amount, server_work work, void *data){
+  server_state state;
+  memset(&state, 0, sizeof(state));
+  state.work = work;
+  state.data = data;
+
+  // The signals are read by the event loop, the workers inherit the mask
+  sigset_t signals, previous_signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, &previous_signals);
+
+  errno = 0;
+  int listen_fd = listenSocket(path);
+  if(listen_fd < 0){
+    pthread_sigmask(SIG_SETMASK, &previous_signals, NULL);
+    return -1;
+  }
+  int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  state.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  state.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  pthread_t *threads = (pthread_t*)malloc(worker_amount*sizeof(pthread_t));
+  server_worker *workers = (server_worker*)malloc(worker_amount*sizeof(server_worker));
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  int failed = signal_fd < 0 || state.epoll_fd < 0 || state.event_fd < 0 || !threads || !workers;
+  if(!failed){
+    event.data.ptr = &listen_fd;
+    failed |= epoll_ctl(state.epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) != 0;
+    event.data.ptr = &signal_fd;
+    failed |= epoll_ctl(state.epoll_fd, EPOLL_CTL_ADD, signal_fd, &event) != 0;
+    event.data.ptr = &state.event_fd;
+    failed |= epoll_ctl(state.epoll_fd, EPOLL_CTL_ADD, state.event_fd, &event) != 0;
+  }
+  pthread_mutex_init(&state.lock, NULL);
+  pthread_cond_init(&state.ready, NULL);
+
+  int started = 0;
+  for(; !failed && started < worker_amount; started++){
+    workers[started].worker = started;
+    workers[started].state = &state;
+    if(pthread_create(&threads[started], NULL, runServerWorker, &workers[started]) != 0){
+      failed = 1;
+      break;
+    }
+  }
+
+  int error_number = errno;
+  struct epoll_event events[SERVER_EVENTS];
+  while(!failed && !state.stopping){
+    int amount = epoll_wait(state.epoll_fd, events, SERVER_EVENTS, -1);
+    if(amount < 0 && errno != EINTR){
+      error_number = errno;
+      failed = 1;
+    }
+    for(int i = 0; i < amount; i++){
+      void *source = events[i].data.ptr;
+      if(source == &listen_fd){
+        acceptClients(&state, listen_fd);
+      }
+      else if(source == &signal_fd){
+        pthread_mutex_lock(&state.lock);
+        state.stopping = 1;
+        pthread_cond_broadcast(&state.ready);
+        pthread_mutex_unlock(&state.lock);
+      }
+      else if(source == &state.event_fd){
+        takeAnswers(&state);
+      }
+    }
+    // Clients are handled after the answers, a client closed by one of them is not used again
+    for(int i = 0; i < amount; i++){
+      void *source = events[i].data.ptr;
+      if(source == &listen_fd || source == &signal_fd || source == &state.event_fd){
+        continue;
+      }
+      server_client *client = (server_client*)source;
+      if(client->closed){
+        continue;
+      }
+      int closing = (events[i].events & (EPOLLERR | EPOLLHUP)) && !(events[i].events & EPOLLIN);
+      if(!closing && (events[i].events & EPOLLIN)){
+        closing = readRequests(&state, client) != 0;
+      }
+      if(!closing && (events[i].events & EPOLLOUT)){
+        closing = sendAnswers(client) != 0 || queueRequests(&state, client) != 0;
+      }
+      if(closing){
+        closeClient(&state, client);
+      }
+      else{
+        finishEvents(&state, client);
+      }
+    }
+    freeClosedClients(&state);
+  }
+
+  // Stop the workers, then free what they held
+  pthread_mutex_lock(&state.lock);
+  state.stopping = 1;
+  pthread_cond_broadcast(&state.ready);
+  pthread_mutex_unlock(&state.lock);
+  for(int i = 0; i < started; i++){
+    pthread_join(threads[i], NULL);
+  }
+  while(state.clients){
+    closeClient(&state, state.clients);
+  }
+  server_task *lists[2] = {state.queue_front, state.done};
+  for(int i = 0; i < 2; i++){
+    while(lists[i]){
+      server_task *next = lists[i]->next;
+      lists[i]->client->in_flight--;
+      free(lists[i]->answer);
+      free(lists[i]);
+      lists[i] = next;
+    }
+  }
+  freeClosedClients(&state);
+
+  // Free ressources
+  pthread_mutex_destroy(&state.lock);
+  pthread_cond_destroy(&state.ready);
+  free(threads);
+  free(workers);
+  if(state.event_fd >= 0){
+    close(state.event_fd);
+  }
+  if(state.epoll_fd >= 0){
+    close(state.epoll_fd);
+  }
+  if(signal_fd >= 0){
+    close(signal_fd);
+  }
+  close(listen_fd);
+  unlink(path);
+  pthread_sigmask(SIG_SETMASK, &previous_signals, NULL);
+  if(failed){
+    errno = error_number;
+    return -1;
+  }
+  return 0;
+}
+
+/// @brief connect to a server
+/// @param connection connection to open
+/// @param path path of the socket of the server
+/// @return 0, or -1 with errno set
+int connectServer(server_connection *connection, const char *path){
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(strlen(path) >= sizeof(address.sun_path)){
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(address.sun_path, path);
+
+  connection->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(connection->fd < 0){
+    return -1;
+  }
+  if(connect(connection->fd, (struct sockaddr*)&address, sizeof(address)) != 0){
+    close(connection->fd);
+    return -1;
+  }
+  // The requests and the answers use their own descriptor, so that each stream can be closed
+  int answers_fd = dup(connection->fd);
+  connection->requests = fdopen(connection->fd, "w");
+  connection->answers = answers_fd >= 0 ? fdopen(answers_fd, "r") : NULL;
+  if(!connection->requests || !connection->answers){
+    int error_number = errno;
+    if(connection->requests){
+      fclose(connection->requests);
+    }
+    else{
+      close(connection->fd);
+    }
+    if(connection->answers){
+      fclose(connection->answers);
+    }
+    else if(answers_fd >= 0){
+      close(answers_fd);
+    }
+    errno = error_number;
+    return -1;
+  }
+  return 0;
+}
+
+/// @brief send a request, buffered until an answer is waited for
+/// @param connection open connection
+/// @param request request without newline
+/// @return 0, or -1 if the server is gone
+int sendRequest(server_connection *connection, const char *request){
+  return fputs(request, connection->requests) < 0 || putc('\n', connection->requests) == EOF ? -1 : 0;
+}
+
+/// @brief wait for the answer of the oldest request
+/// @param connection open connection
+/// @param buffer buffer of the answer, grown when needed
+/// @param capacity number of bytes allowed for buffer
+/// @return the answer stored in buffer without its newline, or NULL if the server is gone
+char* readAnswer(server_connection *connection, char **buffer, size_t *capacity){
+  if(fflush(connection->requests) == EOF){
+    return NULL;
+  }
+  ssize_t length = getline(buffer, capacity, connection->answers);
+  if(length <= 0 || (*buffer)[length-1] != '\n'){
+    return NULL;
+  }
+  (*buffer)[length-1] = '\0';
+  return *buffer;
+}
+
+/// @brief close a connection
+/// @param connection open connection
+void disconnectServer(server_connection *connection){
+  fclose(connection->requests);
+  fclose(connection->answers);
+}
@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <immintrin.h>
+#include "include/colorflow.h"
+
+// Row summing kernels used by sumRow
+// A pixel is 4 bytes, so every 4th byte of a vector belongs to the same channel: the bytes are widened
+// to 16 bits and added lane by lane, the 16 bit sums are widened to 32 bits before they can overflow,
+// and the 32 bit sums are spilled into the 64 bit sums of the caller at the end of the span or of a block
+
+typedef void (*sum_kernel)(int64_t *sums, const pixel *row, int count);
+
+// 255 * 2^24 still fits in an unsigned 32 bit sum
+#define PIXELS_PER_SPILL (1 << 24)
+
+/// @brief add the RGBA values of count pixels one at a time
+/// @param sums array we want to add the RGBA values into
+/// @param row first pixel of the span
+/// @param count number of pixels of the span
+static void sumRowScalar(int64_t *sums, const pixel *row, int count){
+  for(int start=0; start<count; start+=PIXELS_PER_SPILL){
+    int end = count - start > PIXELS_PER_SPILL ? start + PIXELS_PER_SPILL : count;
+    uint32_t red = 0, green = 0, blue = 0, alpha = 0;
+    for(int x=start; x<end; x++){
+      red += row[x].red;
+      green += row[x].green;
+      blue += row[x].blue;
+      alpha += row[x].alpha;
+    }
+    sums[0] += red;
+    sums[1] += green;
+    sums[2] += blue;
+    sums[3] += alpha;
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Each 16 bit lane gets 2 pixels of 255 per step, 128 steps stay below 65536
+#define STEPS_PER_FLUSH 128
+
+// Each 32 bit lane gets two 16 bit lanes of at most 65280 per flush, 2^14 flushes stay below 2^31
+#define FLUSHES_PER_SPILL (1 << 14)
+
+/// @brief add four 32 bit lanes holding R,G,B,A into the 64 bit sums
+__attribute__((target("sse2")))
+static void spillLanes(int64_t *sums, __m128i total){
+  uint32_t lanes[4];
+  _mm_storeu_si128((__m128i*)lanes, total);
+  for(int i=0;i<4;i++){
+    sums[i] += lanes[i];
+  }
+}
+
+/// @brief add the RGBA values of count pixels 4 at a time with SSE2
+__attribute__((target("sse2")))
+static void sumRowSSE2(int64_t *sums, const pixel *row, int count){
+  const __m128i zero = _mm_setzero_si128();
+  __m128i total = _mm_setzero_si128();      // R,G,B,A on 32 bits
+  int x = 0;
+  int flushes = 0;
+
+  while(count - x >= 4){
+    int steps = (count - x)/4;
+    if(steps > STEPS_PER_FLUSH){
+      steps = STEPS_PER_FLUSH;
+    }
+    __m128i partial = _mm_setzero_si128();  // R,G,B,A,R,G,B,A on 16 bits
+    for(int i=0; i<steps; i++, x+=4){
+      __m128i bytes = _mm_loadu_si128((const __m128i*)(row + x));
+      partial = _mm_add_epi16(partial, _mm_add_epi16(_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero)));
+    }
+    total = _mm_add_epi32(total, _mm_add_epi32(_mm_unpacklo_epi16(partial, zero), _mm_unpackhi_epi16(partial, zero)));
+    if(++flushes == FLUSHES_PER_SPILL){
+      spillLanes(sums, total);
+      total = _mm_setzero_si128();
+      flushes = 0;
+    }
+  }
+
+  spillLanes(sums, total);
+  sumRowScalar(sums, row + x, count - x);
+}
+
+/// @brief add the RGBA values of count pixels 8 at a time with AVX2
+__attribute__((target("avx2")))
+static void sumRowAVX2(int64_t *sums, const pixel *row, int count){
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i total = _mm256_setzero_si256();
+  int x = 0;
+  int flushes = 0;
+
+  while(count - x >= 8){
+    int steps = (count - x)/8;
+    if(steps > STEPS_PER_FLUSH){
+      steps = STEPS_PER_FLUSH;
+    }
+    __m256i partial = _mm256_setzero_si256();
+    for(int i=0; i<steps; i++, x+=8){
+      __m256i bytes = _mm256_loadu_si256((const __m256i*)(row + x));
+      partial = _mm256_add_epi16(partial, _mm256_add_epi16(_mm256_unpacklo_epi8(bytes, zero), _mm256_unpackhi_epi8(bytes, zero)));
+    }
+    total = _mm256_add_epi32(total, _mm256_add_epi32(_mm256_unpacklo_epi16(partial, zero), _mm256_unpackhi_epi16(partial, zero)));
+    if(++flushes == FLUSHES_PER_SPILL){
+      spillLanes(sums, _mm256_castsi256_si128(total));
+      spillLanes(sums, _mm256_extracti128_si256(total, 1));
+      total = _mm256_setzero_si256();
+      flushes = 0;
+    }
+  }
+
+  spillLanes(sums, _mm256_castsi256_si128(total));
+  spillLanes(sums, _mm256_extracti128_si256(total, 1));
+  sumRowScalar(sums, row + x, count - x);
+}
+
+/// @brief add the four groups of R,G,B,A 32 bit lanes of an AVX-512 vector into the 64 bit sums
+__attribute__((target("avx512f,avx512bw")))
+static void spillAVX512(int64_t *sums, __m512i total){
+  spillLanes(sums, _mm512_extracti32x4_epi32(total, 0));
+  spillLanes(sums, _mm512_extracti32x4_epi32(total, 1));
+  spillLanes(sums, _mm512_extracti32x4_epi32(total, 2));
+  spillLanes(sums, _mm512_extracti32x4_epi32(total, 3));
+}
+
+/// @brief add the RGBA values of count pixels 16 at a time with AVX-512
+__attribute__((target("avx512f,avx512bw")))
+static void sumRowAVX512(int64_t *sums, const pixel *row, int count){
+  const __m512i zero = _mm512_setzero_si512();
+  __m512i total = _mm512_setzero_si512();
+  int x = 0;
+  int flushes = 0;
+
+  while(count - x >= 16){
+    int steps = (count - x)/16;
+    if(steps > STEPS_PER_FLUSH){
+      steps = STEPS_PER_FLUSH;
+    }
+    __m512i partial = _mm512_setzero_si512();
+    for(int i=0; i<steps; i++, x+=16){
+      __m512i bytes = _mm512_loadu_si512((const void*)(row + x));
+      partial = _mm512_add_epi16(partial, _mm512_add_epi16(_mm512_unpacklo_epi8(bytes, zero), _mm512_unpackhi_epi8(bytes, zero)));
+    }
+    total = _mm512_add_epi32(total, _mm512_add_epi32(_mm512_unpacklo_epi16(partial, zero), _mm512_unpackhi_epi16(partial, zero)));
+    if(++flushes == FLUSHES_PER_SPILL){
+      spillAVX512(sums, total);
+      total = _mm512_setzero_si512();
+      flushes = 0;
+    }
+  }
+
+  spillAVX512(sums, total);
+  sumRowScalar(sums, row + x, count - x);
+}
+
+static int supportsSSE2(void){ return __builtin_cpu_supports("sse2"); }
+static int supportsAVX2(void){ return __builtin_cpu_supports("avx2"); }
+static int supportsAVX512(void){ return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"); }
+
+#endif
+
+static int supportsScalar(void){ return 1; }
+
+// Kernels from the slowest to the fastest
+static const struct{
+  const char *name;
+  sum_kernel sum;
+  int (*supported)(void);
+} kernels[] = {
+  {"scalar", sumRowScalar, supportsScalar},
+#if defined(__x86_64__) || defined(__i386__)
+  {"sse2", sumRowSSE2, supportsSSE2},
+  {"avx2", sumRowAVX2, supportsAVX2},
+  {"avx512", sumRowAVX512, supportsAVX512},
+#endif
+};
+
+#define KERNEL_AMOUNT ((int)(sizeof(kernels)/sizeof(kernels[0])))
+
+// Index of the kernel used by sumRow, -1 until the processor has been checked
+static int selected_kernel = -1;
+
+/// @brief choose the kernel named by COLORFLOW_KERNEL, or the fastest kernel supported by the processor
+/// @return index of the kernel
+static int detectSumKernel(void){
+  // The scalar kernel is always supported
+  int fastest = KERNEL_AMOUNT-1;
+  while(!kernels[fastest].supported()){
+    fastest--;
+  }
+
+  const char *name = getenv("COLORFLOW_KERNEL");
+  if(name && *name){
+    for(int i=0; i<KERNEL_AMOUNT; i++){
+      if(strcmp(name, kernels[i].name) == 0 && kernels[i].supported()){
+        return i;
+      }
+    }
+    // A misspelled or unsupported kernel must not be timed or tested under its name
+    fprintf(stderr,"Warning: COLORFLOW_KERNEL=%s is not a kernel supported by this processor, %s is used\n", name, kernels[fastest].name);
+  }
+  return fastest;
+}
+
+/// @brief index of the kernel used by sumRow, detected on the first call
+static int getSumKernel(void){
+  int kernel = __atomic_load_n(&selected_kernel, __ATOMIC_RELAXED);
+  if(kernel == -1){
+    kernel = detectSumKernel();
+    __atomic_store_n(&selected_kernel, kernel, __ATOMIC_RELAXED);
+  }
+  return kernel;
+}
+
+/// @brief name of the kernel used by sumRow
+/// @return "scalar", "sse2", "avx2" or "avx512"
+const char *sumKernelName(void){
+  return kernels[getSumKernel()].name;
+}
+
+/// @brief force the kernel used by sumRow
+/// @param name "scalar", "sse2", "avx2" or "avx512"
+/// @return 0, or -1 if the kernel is unknown or not supported by the processor
+int selectSumKernel(const char *name){
+  for(int i=0; i<KERNEL_AMOUNT; i++){
+    if(strcmp(name, kernels[i].name) == 0 && kernels[i].supported()){
+      __atomic_store_n(&selected_kernel, i, __ATOMIC_RELAXED);
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/// @brief add the RGBA values of the pixels of a row between start_column and end_column
+/// @param sums array we want to add the RGBA values into
+/// @param row row of pixels
+/// @param start_column specifies on which column the span starts
+/// @param end_column specifies on which column the span ends
+void sumRow(int64_t *sums, pixel *row, int start_column, int end_column){
+  if(end_column > start_column){
+    kernels[getSumKernel()].sum(sums, row + start_column, end_column - start_column);
+  }
+}
@@ -0,0 +1,45 @@
+// Check the pictures decoded whole by colorflow_decode: every row starts on a 64 byte boundary,
+// and the frame of the decoded picture has the color computed by colorflow_compute
+//
+// Usage: ./tests/decoded_rows FILE...
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "../include/colorflow.h"
+
+int main(int argc, char *argv[]){
+  colorflow_ctx *ctx = colorflow_ctx_create();
+  if(!ctx){
+    fprintf(stderr,"Error while allowing memory.\n");
+    return 1;
+  }
+  colorflow_options options;
+  memset(&options, 0, sizeof(options));
+  options.frame_percentage = 0.1f;
+
+  int failures = 0;
+  for(int i=1; i<argc; i++){
+    colorflow_result result;
+    if(colorflow_compute(ctx, argv[i], &options, &result) != COLORFLOW_OK || colorflow_decode(ctx, argv[i], &options) != COLORFLOW_OK){
+      printf("%s failed to decode\n", argv[i]);
+      failures++;
+      continue;
+    }
+
+    int aligned = 1;
+    for(int y=0; y<ctx->height; y++){
+      aligned = aligned && (uintptr_t)(ctx->pixels + (size_t)y*ctx->stride) % 64 == 0;
+    }
+    int average_RGBA[4];
+    getAverageColor(ctx, ctx->pixels, ctx->stride, options.frame_percentage, average_RGBA);
+    int same = memcmp(average_RGBA, result.average_RGBA, sizeof(average_RGBA)) == 0;
+
+    printf("%s %dx%d stride %zu %02X%02X%02X-%02X %s\n", argv[i], ctx->width, ctx->height, ctx->stride, average_RGBA[0], average_RGBA[1], average_RGBA[2], average_RGBA[3], aligned && same ? "ok" : aligned ? "wrong color" : "unaligned rows");
+    failures += !(aligned && same);
+  }
+
+  colorflow_ctx_destroy(ctx);
+  return failures ? 1 : 0;
+}
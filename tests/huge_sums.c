@@ -0,0 +1,84 @@
+// Check the border sums of a picture too big for 32 bit sums, with every row summing kernel
+//
+// The picture is synthetic: every row is the same, so the expected sums are the sums of one row
+// multiplied by the number of rows of each border, computed with plain 64 bit loops.
+//
+// Usage: ./tests/huge_sums [width] [height]
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "../include/colorflow.h"
+
+static const char *kernel_names[] = {"scalar", "sse2", "avx2", "avx512"};
+
+/// @brief add the RGBA values of a span with a plain 64 bit loop
+static void referenceSum(int64_t *sums, pixel *row, int start_column, int end_column){
+  for(int x=start_column; x<end_column; x++){
+    sums[0] += row[x].red;
+    sums[1] += row[x].green;
+    sums[2] += row[x].blue;
+    sums[3] += row[x].alpha;
+  }
+}
+
+int main(int argc, char *argv[]){
+  // 17M pixels of 255 per row already overflow 32 bits
+  int width = argc > 1 ? atoi(argv[1]) : 17000000;
+  int height = argc > 2 ? atoi(argv[2]) : 20;
+  float frame_percentage = 0.5f;
+
+  pixel *row = (pixel*)malloc((size_t)width*sizeof(pixel));
+  if(!row){
+    fprintf(stderr,"Error while allowing memory.\n");
+    return 1;
+  }
+  for(int x=0; x<width; x++){
+    row[x] = createPixel(255 - (x & 7), 200 + (x % 51), 255, 255);
+  }
+
+  colorflow_ctx *ctx = colorflow_ctx_create();
+  ctx->width = width;
+  ctx->height = height;
+
+  // Expected average color of the frame
+  border_accumulator expected;
+  initBorderAccumulator(ctx, &expected, frame_percentage);
+  int64_t full[4] = {0,0,0,0}, right[4] = {0,0,0,0}, left[4] = {0,0,0,0};
+  referenceSum(full, row, 0, width);
+  referenceSum(right, row, expected.right_start, width);
+  referenceSum(left, row, 0, expected.left_end);
+  for(int i=0;i<4;i++){
+    expected.up[i] = full[i]*expected.up_end;
+    expected.down[i] = full[i]*(height - expected.down_start);
+    expected.right[i] = right[i]*height;
+    expected.left[i] = left[i]*height;
+  }
+  int expected_RGBA[4];
+  computeAverageColor(ctx, &expected, expected_RGBA);
+
+  int failures = 0;
+  for(int k=0; k<(int)(sizeof(kernel_names)/sizeof(kernel_names[0])); k++){
+    if(selectSumKernel(kernel_names[k])){
+      continue;
+    }
+    border_accumulator accumulator;
+    initBorderAccumulator(ctx, &accumulator, frame_percentage);
+    for(int y=0; y<height; y++){
+      accumulateRow(&accumulator, y, row);
+    }
+    int average_RGBA[4];
+    computeAverageColor(ctx, &accumulator, average_RGBA);
+
+    int ok = 1;
+    for(int i=0;i<4;i++){
+      ok = ok && average_RGBA[i] == expected_RGBA[i];
+    }
+    printf("%-8s %dx%d %02X%02X%02X-%02X %s\n", kernel_names[k], width, height, average_RGBA[0], average_RGBA[1], average_RGBA[2], average_RGBA[3], ok ? "ok" : "failed");
+    failures += !ok;
+  }
+
+  colorflow_ctx_destroy(ctx);
+  free(row);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "include/trace.h"
+
+/// @brief allocate a ring of spans for every thread and start the clock of the trace
+/// @param trace trace to set up
+/// @param thread_amount number of threads adding spans
+/// @param capacity number of spans kept by each thread
+/// @return 0, or -1 if the memory could not be allocated
+int openTrace(trace_recorder *trace, int thread_amount, size_t capacity){
+  trace->rings = (trace_ring*)calloc(thread_amount, sizeof(trace_ring));
+  if(!trace->rings){
+    return -1;
+  }
+  trace->thread_amount = thread_amount;
+
+  // The spans are allocated once, their pages are only touched when the spans are written
+  for(int i = 0; i < thread_amount; i++){
+    trace->rings[i].spans = (trace_span*)calloc(capacity, sizeof(trace_span));
+    if(!trace->rings[i].spans){
+      closeTrace(trace);
+      return -1;
+    }
+    trace->rings[i].capacity = capacity;
+  }
+
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  trace->origin = (int64_t)time.tv_sec*1000000000 + time.tv_nsec;
+  return 0;
+}
+
+/// @brief add a span to the ring of a thread, overwriting its oldest span when it is full
+/// @param trace trace set up by openTrace
+/// @param thread index of the calling thread, the only one that adds to this ring
+/// @param span span to add, the name of its file is kept as a pointer and only read by writeTrace
+void addTraceSpan(trace_recorder *trace, int thread, const trace_span *span){
+  trace_ring *ring = &trace->rings[thread];
+  ring->spans[ring->written % ring->capacity] = *span;
+  ring->written++;
+}
+
+/// @brief write a string as a JSON string, between quotes
+/// @param file file to write to
+/// @param string string to escape
+static void writeJSONString(FILE *file, const char *string){
+  fputc('"', file);
+  for(const unsigned char *c = (const unsigned char*)string; *c; c++){
+    if(*c == '"' || *c == '\\'){
+      fprintf(file, "\\%c", *c);
+    }
+    else if(*c < 0x20){
+      fprintf(file, "\\u%04x", *c);
+    }
+    else{
+      fputc(*c, file);
+    }
+  }
+  fputc('"', file);
+}
+
+/// @brief write a span as a complete event, its times in microseconds from the start of the trace
+/// @param file file to write to
+/// @param trace trace the span belongs to
+/// @param pid process of the span
+/// @param tid thread of the span
+/// @param span span to write
+static void writeSpan(FILE *file, trace_recorder *trace, int pid, int tid, trace_span *span){
+  fprintf(file, ",\n{\"name\":");
+  writeJSONString(file, span->name);
+  fprintf(file, ",\"cat\":\"colorflow\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{", (span->start - trace->origin)/1e3, (span->end - span->start)/1e3, pid, tid);
+  const char *separator = "";
+  if(span->file){
+    fprintf(file, "\"file\":");
+    writeJSONString(file, span->file);
+    separator = ",";
+  }
+  if(span->width || span->height){
+    fprintf(file, "%s\"width\":%d,\"height\":%d", separator, span->width, span->height);
+    separator = ",";
+  }
+  if(span->value_name){
+    fprintf(file, "%s\"%s\":%lld", separator, span->value_name, (long long)span->value);
+  }
+  fprintf(file, "}}");
+}
+
+/// @brief write the spans of every thread to a JSON trace, the threads are named after their workers
+/// @param trace trace set up by openTrace
+/// @param path path of the trace file, replaced if it exists
+/// @return number of spans lost because a ring was full, or -1 with errno set if the file could not be written
+long long writeTrace(trace_recorder *trace, const char *path){
+  FILE *file = fopen(path, "w");
+  if(!file){
+    return -1;
+  }
+  int pid = (int)getpid();
+  long long lost = 0;
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"colorflow\"}}", pid);
+  for(int i = 0; i < trace->thread_amount; i++){
+    trace_ring *ring = &trace->rings[i];
+    fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"worker %d\"}}", pid, i + 1, i);
+
+    // The oldest span kept comes first
+    uint64_t first = ring->written > ring->capacity ? ring->written - ring->capacity : 0;
+    for(uint64_t k = first; k < ring->written; k++){
+      writeSpan(file, trace, pid, i + 1, &ring->spans[k % ring->capacity]);
+    }
+    lost += first;
+  }
+  fprintf(file, "\n]}\n");
+
+  if(fclose(file) != 0){
+    return -1;
+  }
+  return lost;
+}
+
+/// @brief free the rings of a trace
+/// @param trace trace set up by openTrace
+void closeTrace(trace_recorder *trace){
+  for(int i = 0; i < trace->thread_amount; i++){
+    free(trace->rings[i].spans);
+  }
+  free(trace->rings);
+  trace->rings = NULL;
+  trace->thread_amount = 0;
+}